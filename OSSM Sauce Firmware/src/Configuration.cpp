@@ -1,5 +1,7 @@
 #include "Configuration.h"
 #include "MotorMovement.h"
+#include "Oscillator.h"
+#include "ControllerServer.h"
 
 // Global variables
 esp_websocket_client_config_t wsConfig;
@@ -16,14 +18,53 @@ uint8_t ledBrightness = 25;  // 0-255, adjust as needed
 // LED status tracking
 LEDStatus currentLEDStatus = LED_OFF;
 
+// Runtime settings cache
+short rangeLimitUserMinInput = 0;
+short rangeLimitUserMaxInput = 10000;
+
+struct StoredSettings {
+  float homingTrigger;
+  uint32_t speedLimitHz;
+  uint32_t acceleration;
+  uint32_t tunedSpeedLimitHz;
+  uint32_t tunedAcceleration;
+  uint32_t homingSpeedHz;
+  short rangeMinInput;
+  short rangeMaxInput;
+  bool motorReversed;
+  bool homingBySwitch;
+  uint32_t railLengthSteps;
+  uint8_t appPriority;
+  uint8_t serialPriority;
+  uint8_t controllerPriority;
+} storedSettings;
+
+bool settingsChanged = false;
+unsigned long settingsChangedMs;
+
+// Animations are rendered by a low priority task on the protocol core so
+// the motion loop never spends time on the status LED
+void ledTask(void *parameter) {
+  while (true) {
+    updateLED();
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+
 void initializeLED() {
   FastLED.addLeds<LED_TYPE, LED_PIN, COLOR_ORDER>(leds, NUM_LEDS);
   FastLED.setBrightness(ledBrightness);
-  setLEDColor(COLOR_OFF);
+  leds[0] = COLOR_OFF;
+  FastLED.show();
+  xTaskCreatePinnedToCore(ledTask, "led", 2048, NULL, 1, NULL, 0);
 }
 
 
+// Only transfer to the LED when the colour actually changes
 void setLEDColor(CRGB color) {
+  if (leds[0] == color)
+    return;
   leds[0] = color;
   FastLED.show();
 }
@@ -34,11 +75,133 @@ void initializeConfiguration() {
   
   preferences.begin("ossm_sauce");
 
-  // Set sensorless homing sensitivity
-  powerAvgRangeMultiplier = preferences.getFloat("homing_trigger", 1.5);
+  loadRuntimeSettings();
   
   Serial.println("");
   Serial.println("=== OSSM Configuration ===");
+  Serial.println("Type 'c' and press Enter at any time to open the configuration menu.");
+}
+
+
+void loadRuntimeSettings() {
+  storedSettings.homingTrigger = preferences.getFloat("homing_trigger", 1.5);
+  storedSettings.speedLimitHz = preferences.getUInt("speed_limit", globalSpeedLimitHz);
+  storedSettings.acceleration = preferences.getUInt("acceleration", globalAcceleration);
+  storedSettings.tunedSpeedLimitHz = preferences.getUInt("tuned_speed", 0);
+  storedSettings.tunedAcceleration = preferences.getUInt("tuned_accel", 0);
+  storedSettings.homingSpeedHz = preferences.getUInt("homing_speed", homingSpeedHz);
+  storedSettings.rangeMinInput = preferences.getShort("range_min", 0);
+  storedSettings.rangeMaxInput = preferences.getShort("range_max", 10000);
+  storedSettings.motorReversed = preferences.getBool("motor_reversed", false);
+  storedSettings.homingBySwitch = preferences.getBool("limit_switch", false);
+  storedSettings.railLengthSteps = preferences.getUInt("rail_steps", 0);
+  storedSettings.appPriority = preferences.getUChar("prio_app", DEFAULT_SOURCE_PRIORITY);
+  storedSettings.serialPriority = preferences.getUChar("prio_serial", DEFAULT_SOURCE_PRIORITY);
+  storedSettings.controllerPriority = preferences.getUChar("prio_ctrl", DEFAULT_SOURCE_PRIORITY);
+
+  // Set sensorless homing sensitivity
+  powerAvgRangeMultiplier = storedSettings.homingTrigger;
+  globalSpeedLimitHz = storedSettings.speedLimitHz;
+  globalAcceleration = storedSettings.acceleration;
+  tunedSpeedLimitHz = storedSettings.tunedSpeedLimitHz;
+  tunedAcceleration = storedSettings.tunedAcceleration;
+  homingBySwitch = storedSettings.homingBySwitch;
+  railLengthSteps = storedSettings.railLengthSteps;
+  motorReversed = storedSettings.motorReversed;
+  appPriority = storedSettings.appPriority;
+  serialPriority = storedSettings.serialPriority;
+  controllerPriority = storedSettings.controllerPriority;
+  homingSpeedHz = storedSettings.homingSpeedHz;
+  rangeLimitUserMinInput = storedSettings.rangeMinInput;
+  rangeLimitUserMaxInput = storedSettings.rangeMaxInput;
+}
+
+
+// Hard limits are only known after homing
+void applyStoredRangeLimits() {
+  rangeLimitUserMin = map(rangeLimitUserMinInput, 0, 10000, rangeLimitHardMin, rangeLimitHardMax);
+  rangeLimitUserMax = map(rangeLimitUserMaxInput, 0, 10000, rangeLimitHardMin, rangeLimitHardMax);
+}
+
+
+void markSettingsChanged() {
+  settingsChanged = true;
+  settingsChangedMs = millis();
+}
+
+
+// Flash writes stall both cores, so only call this while the motor is idle.
+// Changes are coalesced and only keys that differ from NVS are written.
+void writeBackSettings() {
+  if (!settingsChanged || millis() - settingsChangedMs < SETTINGS_WRITE_DELAY_MS)
+    return;
+  flushSettings();
+}
+
+
+// Writes pending changes without waiting, for when the device is about to
+// restart. The motor must be stopped.
+void flushSettings() {
+  settingsChanged = false;
+
+  if (storedSettings.homingTrigger != powerAvgRangeMultiplier) {
+    storedSettings.homingTrigger = powerAvgRangeMultiplier;
+    preferences.putFloat("homing_trigger", powerAvgRangeMultiplier);
+  }
+  if (storedSettings.speedLimitHz != globalSpeedLimitHz) {
+    storedSettings.speedLimitHz = globalSpeedLimitHz;
+    preferences.putUInt("speed_limit", globalSpeedLimitHz);
+  }
+  if (storedSettings.acceleration != globalAcceleration) {
+    storedSettings.acceleration = globalAcceleration;
+    preferences.putUInt("acceleration", globalAcceleration);
+  }
+  if (storedSettings.tunedSpeedLimitHz != tunedSpeedLimitHz) {
+    storedSettings.tunedSpeedLimitHz = tunedSpeedLimitHz;
+    preferences.putUInt("tuned_speed", tunedSpeedLimitHz);
+  }
+  if (storedSettings.tunedAcceleration != tunedAcceleration) {
+    storedSettings.tunedAcceleration = tunedAcceleration;
+    preferences.putUInt("tuned_accel", tunedAcceleration);
+  }
+  if (storedSettings.homingSpeedHz != homingSpeedHz) {
+    storedSettings.homingSpeedHz = homingSpeedHz;
+    preferences.putUInt("homing_speed", homingSpeedHz);
+  }
+  if (storedSettings.rangeMinInput != rangeLimitUserMinInput) {
+    storedSettings.rangeMinInput = rangeLimitUserMinInput;
+    preferences.putShort("range_min", rangeLimitUserMinInput);
+  }
+  if (storedSettings.rangeMaxInput != rangeLimitUserMaxInput) {
+    storedSettings.rangeMaxInput = rangeLimitUserMaxInput;
+    preferences.putShort("range_max", rangeLimitUserMaxInput);
+  }
+  if (storedSettings.motorReversed != motorReversed) {
+    storedSettings.motorReversed = motorReversed;
+    preferences.putBool("motor_reversed", motorReversed);
+  }
+  if (storedSettings.homingBySwitch != homingBySwitch) {
+    storedSettings.homingBySwitch = homingBySwitch;
+    preferences.putBool("limit_switch", homingBySwitch);
+  }
+  if (storedSettings.railLengthSteps != railLengthSteps) {
+    storedSettings.railLengthSteps = railLengthSteps;
+    preferences.putUInt("rail_steps", railLengthSteps);
+  }
+  if (storedSettings.appPriority != appPriority) {
+    storedSettings.appPriority = appPriority;
+    preferences.putUChar("prio_app", appPriority);
+  }
+  if (storedSettings.serialPriority != serialPriority) {
+    storedSettings.serialPriority = serialPriority;
+    preferences.putUChar("prio_serial", serialPriority);
+  }
+  if (storedSettings.controllerPriority != controllerPriority) {
+    storedSettings.controllerPriority = controllerPriority;
+    preferences.putUChar("prio_ctrl", controllerPriority);
+  }
+  if (vibrationResponseChanged)
+    saveVibrationResponse();
 }
 
 
@@ -67,8 +230,7 @@ void updateLED() {
           }
         }
         
-        leds[0] = CRGB(0, 0, breatheValue);  // Blue breathing
-        FastLED.show();
+        setLEDColor(CRGB(0, 0, breatheValue));  // Blue breathing
         lastLEDUpdate = now;
       }
       break;
@@ -190,7 +352,6 @@ bool testWebSocketConnection(String address) {
   int attempts = 50;
   while (attempts > 0 && !esp_websocket_client_is_connected(testClient)) {
     delay(100);
-    updateLED();
     attempts--;
   }
   
@@ -216,291 +377,499 @@ bool testWebSocketConnection(String address) {
 }
 
 
-String getSerialInput(String prompt) {
-  Serial.println(prompt);
-  while (!Serial.available()) {
-    delay(100);
-    updateLED();
+// Configuration console, fed from the serial poll a character at a time so
+// the motion loop never waits on it. Each prompt acts on one complete line.
+enum ConsolePrompt {
+  CONSOLE_CLOSED,
+  CONSOLE_MENU,
+  CONSOLE_RETURN,
+  CONSOLE_WS_SERVER,
+  CONSOLE_WIFI_SSID,
+  CONSOLE_WIFI_PASS,
+  CONSOLE_SENSITIVITY,
+  CONSOLE_DIRECTION,
+  CONSOLE_SERVER_PORT,
+  CONSOLE_HOMING_METHOD,
+  CONSOLE_RAIL_LENGTH,
+  CONSOLE_RESET,
+  CONSOLE_PRIORITIES
+};
+
+ConsolePrompt consolePrompt = CONSOLE_CLOSED;
+LEDStatus consoleReturnLEDStatus = LED_OFF;
+char consoleLine[CONSOLE_LINE_SIZE];
+size_t consoleLineLength = 0;
+bool consoleLastCR = false;
+String consoleSSID;
+
+// Console text is queued and drained a bit per loop as the UART has room,
+// so printing the menu never holds up the motion loop. Text that does not
+// fit is dropped.
+char consoleOutput[CONSOLE_OUTPUT_SIZE];
+size_t consoleOutputHead = 0;
+size_t consoleOutputTail = 0;
+
+
+void consolePrintln(String text) {
+  text += "\r\n";
+  size_t used = (consoleOutputHead - consoleOutputTail + CONSOLE_OUTPUT_SIZE) % CONSOLE_OUTPUT_SIZE;
+  if (used + text.length() >= CONSOLE_OUTPUT_SIZE)
+    return;
+  for (size_t i = 0; i < text.length(); i++) {
+    consoleOutput[consoleOutputHead] = text[i];
+    consoleOutputHead = (consoleOutputHead + 1) % CONSOLE_OUTPUT_SIZE;
+  }
+}
+
+
+// Called every loop, never blocks
+void drainConsoleOutput() {
+  int room = Serial.availableForWrite();
+  while (room > 0 && consoleOutputTail != consoleOutputHead) {
+    size_t end = (consoleOutputHead > consoleOutputTail) ? consoleOutputHead : CONSOLE_OUTPUT_SIZE;
+    size_t length = min(end - consoleOutputTail, (size_t)room);
+    Serial.write((const uint8_t*)consoleOutput + consoleOutputTail, length);
+    consoleOutputTail = (consoleOutputTail + length) % CONSOLE_OUTPUT_SIZE;
+    room -= length;
   }
-  String input = Serial.readString();
-  input.trim();
-  return input;
+}
+
+
+// Blocks until the queue is empty, only where the loop is not running
+void flushConsoleOutput() {
+  while (consoleOutputTail != consoleOutputHead) {
+    drainConsoleOutput();
+    delay(1);
+  }
+}
+
+
+void promptConsole(ConsolePrompt prompt, String text) {
+  consolePrompt = prompt;
+  if (text.length() > 0)
+    consolePrintln(text);
+}
+
+
+// The console runs from the motion loop, so options that write flash
+// directly, restart the device or change how homing works are only taken
+// while the motor is idle
+bool consoleMotorIdle() {
+  if (movementMode == MODE_IDLE)
+    return true;
+  consolePrintln("ERROR: Stop the motor before changing this setting.");
+  return false;
+}
+
+
+void restartDevice() {
+  flushConsoleOutput();
+  if (stepper) {
+    stepper->stopMove();
+    while (stepper->isRunning())
+      delay(10);
+  }
+  delay(2000);
+  ESP.restart();
 }
 
 
 void showConfigMenu() {
   currentLEDStatus = LED_CONFIG_MODE;
   
-  Serial.println("");
-  Serial.println("=================================");
-  Serial.println("       CONFIGURATION MENU");
-  Serial.println("=================================");
-  Serial.println("");
+  consolePrintln("");
+  consolePrintln("=================================");
+  consolePrintln("       CONFIGURATION MENU");
+  consolePrintln("=================================");
+  consolePrintln("");
+  
+  consolePrintln("Current Settings:");
+  consolePrintln("WiFi SSID: " + preferences.getString("wifi_ssid", "Not set"));
+  consolePrintln("WebSocket Server: " + preferences.getString("ws_server", "Not set"));
+  consolePrintln("Homing Sensitivity: " + String(powerAvgRangeMultiplier));
+  uint16_t serverPort = preferences.getUShort("server_port", 0);
+  consolePrintln("Controller Server: " + (serverPort ? "Port " + String(serverPort) : String("Off")));
+  if (homingBySwitch) {
+    consolePrintln("Homing: Limit switch, " + (railLengthSteps ? String(railLengthSteps) + " step rail" : String("far end sensorless")));
+  } else {
+    consolePrintln("Homing: Sensorless");
+  }
+  consolePrintln("Control Priority: App " + String(appPriority) + ", Serial " + String(serialPriority) + ", Controllers " + String(controllerPriority));
+  consolePrintln("");
+  
+  consolePrintln("Options:");
+  consolePrintln("1. Show system information");
+  consolePrintln("2. Update WebSocket server address");
+  consolePrintln("3. Update WiFi credentials");
+  consolePrintln("4. Update sensorless homing sensitivity");
+  consolePrintln("5. Reverse motor direction");
+  consolePrintln("6. Controller server port");
+  consolePrintln("7. Homing method");
+  consolePrintln("8. Reset all settings");
+  consolePrintln("9. Control priorities");
+  consolePrintln("10. Continue with current settings");
+  consolePrintln("");
+  promptConsole(CONSOLE_MENU, "Enter your choice (1-10):");
+}
+
+
+void showSystemInformation() {
+  consolePrintln("");
+  consolePrintln("=================================");
+  consolePrintln("       SYSTEM INFORMATION");
+  consolePrintln("=================================");
+  consolePrintln("");
+  
+  consolePrintln("WiFi Network:");
+  consolePrintln("  SSID: " + WiFi.SSID());
+  
+  int rssi = WiFi.RSSI();
+  consolePrintln("  Signal Strength: " + String(rssi) + " dBm");
+  if (rssi > -50) {
+    consolePrintln("    (Excellent signal)");
+  } else if (rssi > -60) {
+    consolePrintln("    (Good signal)");
+  } else if (rssi > -70) {
+    consolePrintln("    (Fair signal)");
+  } else {
+    consolePrintln("    (Weak signal)");
+  }
   
-  Serial.println("Current Settings:");
-  Serial.println("WiFi SSID: " + preferences.getString("wifi_ssid", "Not set"));
-  Serial.println("WebSocket Server: " + preferences.getString("ws_server", "Not set"));
-  Serial.println("Homing Sensitivity: " + String(powerAvgRangeMultiplier));
-  Serial.println("");
+  consolePrintln("  IP Address: " + WiFi.localIP().toString());
+  consolePrintln("  Gateway: " + WiFi.gatewayIP().toString());
+  consolePrintln("  Subnet Mask: " + WiFi.subnetMask().toString());
+  consolePrintln("  DNS Server: " + WiFi.dnsIP().toString());
+  consolePrintln("  MAC Address: " + WiFi.macAddress());
+  consolePrintln("  Channel: " + String(WiFi.channel()));
+  consolePrintln("");
+  
+  consolePrintln("WebSocket Connection:");
+  String currentServer = preferences.getString("ws_server", "Not configured");
+  consolePrintln("  Configured Server: " + currentServer);
+  
+  if (wsClient != nullptr && esp_websocket_client_is_connected(wsClient)) {
+    consolePrintln("  Status: ✓ Connected");
+  } else if (wsClient != nullptr) {
+    consolePrintln("  Status: ✗ Disconnected");
+  } else {
+    consolePrintln("  Status: Not initialized");
+  }
+  consolePrintln("");
   
-  Serial.println("Options:");
-  Serial.println("1. Show system information");
-  Serial.println("2. Update WebSocket server address");
-  Serial.println("3. Update WiFi credentials");
-  Serial.println("4. Update sensorless homing sensitivity");
-  Serial.println("5. Reverse motor direction");
-  Serial.println("6. Reset all settings");
-  Serial.println("7. Continue with current settings");
-  Serial.println("");
-  Serial.println("Enter your choice (1-7):");
+  consolePrintln("System Information:");
+  consolePrintln("  Uptime: " + String(millis() / 1000) + " seconds");
+  consolePrintln("  Free Heap: " + String(ESP.getFreeHeap()) + " bytes");
+  consolePrintln("  Chip Model: " + String(ESP.getChipModel()));
+  consolePrintln("  CPU Frequency: " + String(ESP.getCpuFreqMHz()) + " MHz");
+  consolePrintln("");
+  
+  promptConsole(CONSOLE_RETURN, "Press Enter to return to menu...");
 }
 
 
-void handleConfigMenu() {
-  showConfigMenu();
+void handleMenuChoice(String choice) {
+  bool needsIdle = choice == "2" || choice == "3" || choice == "6" || choice == "7" || choice == "8";
+  if (needsIdle && !consoleMotorIdle())
+    return;
   
-  while (true) {
-    while (!Serial.available()) {
-      delay(100);
-      updateLED();
-    }
+  if (choice == "1") {
+    showSystemInformation();
     
-    String choice = Serial.readString();
-    choice.trim();
+  } else if (choice == "2") {
+    promptConsole(CONSOLE_WS_SERVER, "Enter WebSocket server address (IP or hostname, port optional):");
     
-    if (choice == "1") {
-      // Display system information
-      Serial.println("");
-      Serial.println("=================================");
-      Serial.println("       SYSTEM INFORMATION");
-      Serial.println("=================================");
-      Serial.println("");
-      
-      Serial.println("WiFi Network:");
-      Serial.println("  SSID: " + WiFi.SSID());
-      
-      int rssi = WiFi.RSSI();
-      Serial.println("  Signal Strength: " + String(rssi) + " dBm");
-      if (rssi > -50) {
-        Serial.println("    (Excellent signal)");
-      } else if (rssi > -60) {
-        Serial.println("    (Good signal)");
-      } else if (rssi > -70) {
-        Serial.println("    (Fair signal)");
-      } else {
-        Serial.println("    (Weak signal)");
-      }
-      
-      Serial.println("  IP Address: " + WiFi.localIP().toString());
-      Serial.println("  Gateway: " + WiFi.gatewayIP().toString());
-      Serial.println("  Subnet Mask: " + WiFi.subnetMask().toString());
-      Serial.println("  DNS Server: " + WiFi.dnsIP().toString());
-      Serial.println("  MAC Address: " + WiFi.macAddress());
-      Serial.println("  Channel: " + String(WiFi.channel()));
-      Serial.println("");
-      
-      Serial.println("WebSocket Connection:");
-      String currentServer = preferences.getString("ws_server", "Not configured");
-      Serial.println("  Configured Server: " + currentServer);
-      
-      if (wsClient != nullptr && esp_websocket_client_is_connected(wsClient)) {
-        Serial.println("  Status: ✓ Connected");
-        currentLEDStatus = LED_CONNECTED;
-      } else if (wsClient != nullptr) {
-        Serial.println("  Status: ✗ Disconnected");
-        currentLEDStatus = LED_ERROR;
-      } else {
-        Serial.println("  Status: Not initialized");
-        currentLEDStatus = LED_ERROR;
-      }
-      Serial.println("");
-      
-      Serial.println("System Information:");
-      Serial.println("  Uptime: " + String(millis() / 1000) + " seconds");
-      Serial.println("  Free Heap: " + String(ESP.getFreeHeap()) + " bytes");
-      Serial.println("  Chip Model: " + String(ESP.getChipModel()));
-      Serial.println("  CPU Frequency: " + String(ESP.getCpuFreqMHz()) + " MHz");
-      Serial.println("");
-      
-      delay(2000);
-      currentLEDStatus = LED_CONFIG_MODE;
-      
-      Serial.println("Press any key to return to menu...");
-      while (!Serial.available()) {
-        delay(100);
-        updateLED();
-      }
-      Serial.readString(); // Clear the input buffer
-      
-    } else if (choice == "2") {
-      // Update WebSocket server
-      String newServer = getSerialInput("Enter WebSocket server address (IP or hostname, port optional):");
+  } else if (choice == "3") {
+    promptConsole(CONSOLE_WIFI_SSID, "Enter WiFi SSID:");
+    
+  } else if (choice == "4") {
+    consolePrintln("");
+    consolePrintln("Current homing sensitivity: " + String(powerAvgRangeMultiplier));
+    consolePrintln("Higher values = less sensitive (default: 1.5)");
+    consolePrintln("Lower values = more sensitive");
+    consolePrintln("Recommended range: 1.0 - 2.0");
+    consolePrintln("SETTING THIS VALUE HIGHER THAN NECESSARY CAN DAMAGE YOUR OSSM");
+    consolePrintln("");
+    promptConsole(CONSOLE_SENSITIVITY, "Enter new sensitivity value:");
+    
+  } else if (choice == "5") {
+    consolePrintln("");
+    consolePrintln("Current motor direction: " + String(motorReversed ? "Reversed" : "Normal"));
+    consolePrintln("");
+    consolePrintln("Options:");
+    consolePrintln("1. Normal direction");
+    consolePrintln("2. Reversed direction");
+    consolePrintln("3. Cancel");
+    consolePrintln("");
+    promptConsole(CONSOLE_DIRECTION, "Enter your choice (1-3):");
+    
+  } else if (choice == "6") {
+    consolePrintln("");
+    consolePrintln("Controllers can connect to the device directly over TCP on this port.");
+    consolePrintln("Enter 0 to turn the server off.");
+    consolePrintln("");
+    promptConsole(CONSOLE_SERVER_PORT, "Enter server port (0 - 65535):");
+    
+  } else if (choice == "7") {
+    consolePrintln("");
+    consolePrintln("Options:");
+    consolePrintln("1. Sensorless homing");
+    consolePrintln("2. Limit switch on GPIO 12, at the end the rail reaches moving backward");
+    consolePrintln("3. Cancel");
+    consolePrintln("");
+    promptConsole(CONSOLE_HOMING_METHOD, "Enter your choice (1-3):");
+    
+  } else if (choice == "8") {
+    promptConsole(CONSOLE_RESET, "Are you sure you want to reset ALL settings? (y/n)");
+    
+  } else if (choice == "9") {
+    consolePrintln("");
+    consolePrintln("When several sources send motion, a higher priority takes control at once.");
+    consolePrintln("Clients cannot raise their own priority.");
+    consolePrintln("");
+    promptConsole(CONSOLE_PRIORITIES, "Enter priorities for app, serial and controllers (0 - 255, e.g. 2 1 1):");
+    
+  } else if (choice == "10") {
+    consolePrintln("Continuing with current settings...");
+    closeConfigConsole();
+    
+  } else {
+    consolePrintln("Invalid choice! Please enter 1-10.");
+  }
+}
+
+
+void handleConsoleLine(String input) {
+  input.trim();
+  
+  switch (consolePrompt) {
+    case CONSOLE_MENU:
+      if (input.length() > 0)
+        handleMenuChoice(input);
+      return;
       
-      if (isValidWebSocketAddress(newServer)) {
-        Serial.println("Validating address format... ✓");
+    case CONSOLE_WS_SERVER:
+      if (!consoleMotorIdle())
+        break;
+      if (isValidWebSocketAddress(input)) {
+        consolePrintln("Validating address format... ✓");
         
-        String serverWithPort = addDefaultPortIfMissing(newServer);
+        String serverWithPort = addDefaultPortIfMissing(input);
         
-        if (serverWithPort != newServer) {
-          Serial.println("No port specified, using default port 8008");
-          Serial.println("Final address: " + serverWithPort);
+        if (serverWithPort != input) {
+          consolePrintln("No port specified, using default port 8008");
+          consolePrintln("Final address: " + serverWithPort);
         } else {
-          Serial.println("Address format is valid!");
+          consolePrintln("Address format is valid!");
         }
         
+        flushSettings();
         preferences.putString("ws_server", serverWithPort);
-        Serial.println("WebSocket server address saved!");
-        Serial.println("Device will restart to apply new WebSocket settings...");
+        consolePrintln("WebSocket server address saved!");
+        consolePrintln("Device will restart to apply new WebSocket settings...");
         
         currentLEDStatus = LED_CONNECTED;
-        delay(1500);
-        
-        ESP.restart();
+        restartDevice();
       } else {
-        Serial.println("Invalid address format!");
-        Serial.println("Examples:");
-        Serial.println("  192.168.1.100        (will use port 8008)");
-        Serial.println("  192.168.1.100:8080   (custom port)");
-        Serial.println("  myserver.local       (will use port 8008)");
-        Serial.println("  myserver.local:3000  (custom port)");
-        
-        currentLEDStatus = LED_ERROR;
-        delay(1000);
+        consolePrintln("Invalid address format!");
+        consolePrintln("Examples:");
+        consolePrintln("  192.168.1.100        (will use port 8008)");
+        consolePrintln("  192.168.1.100:8080   (custom port)");
+        consolePrintln("  myserver.local       (will use port 8008)");
+        consolePrintln("  myserver.local:3000  (custom port)");
       }
+      break;
       
-    } else if (choice == "3") {
-      // Update WiFi credentials
-      String newSSID = getSerialInput("Enter WiFi SSID:");
-      String newPassword = getSerialInput("Enter WiFi password:");
-      
-      preferences.putString("wifi_ssid", newSSID);
-      preferences.putString("wifi_pass", newPassword);
-      Serial.println("WiFi credentials updated! Device will restart to apply changes.");
-      delay(2000);
-      ESP.restart();
-      
-    } else if (choice == "4") {
-      // Update sensorless homing sensitivity
-      Serial.println("");
-      Serial.println("Current homing sensitivity: " + String(powerAvgRangeMultiplier));
-      Serial.println("Higher values = less sensitive (default: 1.5)");
-      Serial.println("Lower values = more sensitive");
-      Serial.println("Recommended range: 1.0 - 2.0");
-      Serial.println("SETTING THIS VALUE HIGHER THAN NECESSARY CAN DAMAGE YOUR OSSM");
-      Serial.println("");
+    case CONSOLE_WIFI_SSID:
+      consoleSSID = input;
+      promptConsole(CONSOLE_WIFI_PASS, "Enter WiFi password:");
+      return;
       
-      String newSensitivity = getSerialInput("Enter new sensitivity value:");
-      float sensitivityValue = newSensitivity.toFloat();
+    case CONSOLE_WIFI_PASS:
+      if (!consoleMotorIdle())
+        break;
+      flushSettings();
+      preferences.putString("wifi_ssid", consoleSSID);
+      preferences.putString("wifi_pass", input);
+      consolePrintln("WiFi credentials updated! Device will restart to apply changes.");
+      restartDevice();
+      break;
       
+    case CONSOLE_SENSITIVITY: {
+      float sensitivityValue = input.toFloat();
       if (sensitivityValue >= 0.1 && sensitivityValue <= 10.0) {
         powerAvgRangeMultiplier = sensitivityValue;
-        preferences.putFloat("homing_trigger", powerAvgRangeMultiplier);
-        
-        Serial.println("Homing sensitivity updated to: " + String(powerAvgRangeMultiplier));
-        Serial.println("Changes will take effect on next homing cycle.");
-        
-        currentLEDStatus = LED_CONNECTED;
-        delay(1500);
+        markSettingsChanged();
+        consolePrintln("Homing sensitivity updated to: " + String(powerAvgRangeMultiplier));
+        consolePrintln("Changes will take effect on next homing cycle.");
       } else {
-        Serial.println("Invalid sensitivity value! Please enter a value between 0.1 and 10.0");
-        currentLEDStatus = LED_ERROR;
-        delay(1000);
+        consolePrintln("Invalid sensitivity value! Please enter a value between 0.1 and 10.0");
       }
+      break;
+    }
       
-    } else if (choice == "5") {
-      // Reverse motor direction
-      bool motorDirectionReversed = preferences.getBool("motor_reversed", false);
-      Serial.println("");
-      Serial.println("Current motor direction: " + String(motorDirectionReversed ? "Reversed" : "Normal"));
-      Serial.println("");
-      Serial.println("Options:");
-      Serial.println("1. Normal direction");
-      Serial.println("2. Reversed direction");
-      Serial.println("3. Cancel");
-      Serial.println("");
+    case CONSOLE_DIRECTION:
+      if (input == "1") {
+        motorReversed = false;
+        markSettingsChanged();
+        consolePrintln("Motor direction set to: Normal");
+        consolePrintln("Changes will take effect during next homing cycle.");
+      } else if (input == "2") {
+        motorReversed = true;
+        markSettingsChanged();
+        consolePrintln("Motor direction set to: Reversed");
+        consolePrintln("Changes will take effect during next homing cycle.");
+      } else if (input == "3") {
+        consolePrintln("Motor direction unchanged.");
+      } else {
+        consolePrintln("Invalid choice! Motor direction unchanged.");
+      }
+      break;
       
-      String directionChoice = getSerialInput("Enter your choice (1-3):");
+    case CONSOLE_SERVER_PORT: {
+      long portValue = input.toInt();
+      if (!consoleMotorIdle())
+        break;
+      if ((portValue > 0 || input == "0") && portValue <= 65535) {
+        flushSettings();
+        preferences.putUShort("server_port", portValue);
+        if (portValue)
+          consolePrintln("Controller server port set to: " + String(portValue));
+        else
+          consolePrintln("Controller server turned off.");
+        consolePrintln("Device will restart to apply changes.");
+        restartDevice();
+      } else {
+        consolePrintln("Invalid port! Please enter a value between 0 and 65535");
+      }
+      break;
+    }
       
-      if (directionChoice == "1") {
-        preferences.putBool("motor_reversed", false);
-        Serial.println("Motor direction set to: Normal");
-        Serial.println("Changes will take effect during next homing cycle.");
-        
-        currentLEDStatus = LED_CONNECTED;
-        delay(1500);
-        
-      } else if (directionChoice == "2") {
-        preferences.putBool("motor_reversed", true);
-        Serial.println("Motor direction set to: Reversed");
-        Serial.println("Changes will take effect during next homing cycle.");
-        
-        currentLEDStatus = LED_CONNECTED;
-        delay(1500);
-        
-      } else if (directionChoice == "3") {
-        Serial.println("Motor direction unchanged.");
-        
+    case CONSOLE_HOMING_METHOD:
+      if (!consoleMotorIdle())
+        break;
+      if (input == "1") {
+        homingBySwitch = false;
+        markSettingsChanged();
+        consolePrintln("Homing method set to: Sensorless");
+        consolePrintln("Changes will take effect during next homing cycle.");
+      } else if (input == "2") {
+        consolePrintln("The far end is found from the rail length, or sensorlessly when it is 0.");
+        promptConsole(CONSOLE_RAIL_LENGTH, "Enter rail length in steps (0 - 1000000):");
+        return;
+      } else if (input == "3") {
+        consolePrintln("Homing method unchanged.");
       } else {
-        Serial.println("Invalid choice! Motor direction unchanged.");
-        currentLEDStatus = LED_ERROR;
-        delay(1000);
+        consolePrintln("Invalid choice! Homing method unchanged.");
       }
+      break;
       
-    } else if (choice == "6") {
-      // Reset all settings
-      Serial.println("Are you sure you want to reset ALL settings? (y/n)");
-      String confirm = getSerialInput("");
-      confirm.toLowerCase();
-      if (confirm == "y") {
-        preferences.clear();
-        Serial.println("All settings cleared! Device will restart.");
-        delay(2000);
-        ESP.restart();
+    case CONSOLE_RAIL_LENGTH: {
+      long railSteps = input.toInt();
+      if (!consoleMotorIdle())
+        break;
+      if ((railSteps > 0 || input == "0") && railSteps <= 1000000) {
+        homingBySwitch = true;
+        railLengthSteps = railSteps;
+        markSettingsChanged();
+        consolePrintln("Homing method set to: Limit switch");
+        consolePrintln("Changes will take effect during next homing cycle.");
+      } else {
+        consolePrintln("Invalid rail length! Homing method unchanged.");
       }
-
-    } else if (choice == "7") {
-      // Continue with current settings
-      Serial.println("Continuing with current settings...");
       break;
+    }
       
-    } else {
-      Serial.println("Invalid choice! Please enter 1-6.");
-      continue;
+    case CONSOLE_PRIORITIES: {
+      int app, serial, controllers;
+      if (sscanf(input.c_str(), "%d %d %d", &app, &serial, &controllers) == 3
+          && app >= 0 && app <= 255 && serial >= 0 && serial <= 255
+          && controllers >= 0 && controllers <= 255) {
+        appPriority = app;
+        serialPriority = serial;
+        controllerPriority = controllers;
+        applyConfiguredPriorities();
+        markSettingsChanged();
+        consolePrintln("Control priorities updated.");
+      } else {
+        consolePrintln("Invalid priorities! Please enter three values between 0 and 255");
+      }
+      break;
     }
-    
-    showConfigMenu();  // Show menu again after most operations
+      
+    case CONSOLE_RESET:
+      input.toLowerCase();
+      if (input == "y" && consoleMotorIdle()) {
+        preferences.clear();
+        consolePrintln("All settings cleared! Device will restart.");
+        restartDevice();
+      }
+      break;
+      
+    default:
+      break;
   }
   
-  currentLEDStatus = LED_OFF;
+  showConfigMenu();  // Show menu again after most operations
 }
 
 
-bool checkForConfigMode() {
-  currentLEDStatus = LED_WAITING_CONFIG;
-  
-  Serial.println("");
-  Serial.println("Press 'c' within 5 seconds to enter configuration mode...");
-  
-  unsigned long startTime = millis();
-  while (millis() - startTime < CONFIG_TIMEOUT_MS) {
-    updateLED();
-    
-    if (Serial.available()) {
-      String input = Serial.readString();
-      input.trim();
-      input.toLowerCase();
-      
-      if (input == "c") {
-        handleConfigMenu();
-        return true;
-      }
+void openConfigConsole() {
+  if (consolePrompt != CONSOLE_CLOSED)
+    return;
+  consoleReturnLEDStatus = currentLEDStatus;
+  consoleLineLength = 0;
+  showConfigMenu();
+}
+
+
+void closeConfigConsole() {
+  consolePrompt = CONSOLE_CLOSED;
+  currentLEDStatus = consoleReturnLEDStatus;
+}
+
+
+bool configConsoleActive() {
+  return consolePrompt != CONSOLE_CLOSED;
+}
+
+
+// Lines end with CR, LF or CRLF. Returns as soon as the console closes so
+// the rest of the input is left for T-Code.
+void pollConfigConsole() {
+  while (consolePrompt != CONSOLE_CLOSED && Serial.available()) {
+    char received = Serial.read();
+    bool lineEnd = received == '\n' || received == '\r';
+    if (received == '\n' && consoleLastCR) {
+      consoleLastCR = false;
+      continue;
+    }
+    consoleLastCR = received == '\r';
+    if (lineEnd) {
+      consoleLine[consoleLineLength] = '\0';
+      consoleLineLength = 0;
+      handleConsoleLine(String(consoleLine));
+    } else if (consoleLineLength < CONSOLE_LINE_SIZE - 1) {
+      consoleLine[consoleLineLength++] = received;
     }
-    delay(50);
   }
-  
-  currentLEDStatus = LED_OFF;
-  Serial.println("Continuing with startup...");
-  return false;
+}
+
+
+// Runs the console in place until it closes, for setup when there is
+// nothing to connect to without the missing setting
+void runConfigConsole() {
+  while (consolePrompt != CONSOLE_CLOSED) {
+    drainConsoleOutput();
+    pollConfigConsole();
+    delay(10);
+  }
+  flushConsoleOutput();
+}
+
+
+void handleConfigMenu() {
+  openConfigConsole();
+  runConfigConsole();
 }
 
 void connectToWiFi() {
@@ -518,7 +887,6 @@ void connectToWiFi() {
   
   for (int i = 0; i < 10 && WiFi.status() != WL_CONNECTED; i++) {
     Serial.print(".");
-    updateLED();
     delay(1000);
   }
 
@@ -528,15 +896,10 @@ void connectToWiFi() {
     Serial.println("No WiFi connection. Please enter WiFi credentials:");
     Serial.println("");
 
-    String newSSID = getSerialInput("Enter WiFi SSID:");
-    String newPassword = getSerialInput("Enter WiFi password:");
-    
-    preferences.putString("wifi_ssid", newSSID);
-    preferences.putString("wifi_pass", newPassword);
-
-    Serial.println("WiFi credentials saved. Restarting...");
-    delay(1000);
-    ESP.restart();
+    // Restarts once the password is entered
+    consoleReturnLEDStatus = LED_ERROR;
+    promptConsole(CONSOLE_WIFI_SSID, "Enter WiFi SSID:");
+    runConfigConsole();
   }
 
   currentLEDStatus = LED_CONNECTED;
@@ -599,7 +962,6 @@ void connectToWebSocketServer() {
   int attempts = 50;  // 5 seconds
   while (attempts > 0 && !esp_websocket_client_is_connected(wsClient)) {
     delay(100);
-    updateLED();
     attempts--;
   }
 
@@ -611,19 +973,8 @@ void connectToWebSocketServer() {
     Serial.println("Failed to connect to WebSocket server");
     currentLEDStatus = LED_ERROR;
     
-    // Offer to enter config mode on connection failure
-    Serial.println("Would you like to update the WebSocket server address? (y/n)");
-    delay(4000);
-    
-    if (Serial.available()) {
-      String input = Serial.readString();
-      input.trim();
-      input.toLowerCase();
-      if (input == "y") {
-        handleConfigMenu();
-        // Try connecting again after config
-        connectToWebSocketServer();
-      }
-    }
+    // The client keeps retrying in the background, a new address can be
+    // entered from the console without holding up startup
+    Serial.println("Type 'c' and press Enter to update the WebSocket server address.");
   }
 }
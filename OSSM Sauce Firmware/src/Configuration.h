@@ -6,7 +6,19 @@
 #include <FastLED.h>
 #include "esp_websocket_client.h"
 
-#define CONFIG_TIMEOUT_MS 5000
+// Longest line the configuration console accepts
+#define CONSOLE_LINE_SIZE 128
+
+// Console text waiting for the UART, enough for the menu and a message
+#define CONSOLE_OUTPUT_SIZE 2048
+
+// Runtime settings are written to NVS only after the device has been idle
+// this long since the last change
+#define SETTINGS_WRITE_DELAY_MS 2000
+
+// The motor must also have been at rest this long, a flash write stalls
+// step generation while FastAccelStepper is still decelerating
+#define SETTINGS_QUIET_MS 500
 
 // RGB LED configuration
 #define LED_PIN 25
@@ -38,19 +50,37 @@ extern esp_websocket_client_handle_t wsClient;
 extern Preferences preferences;
 extern CRGB leds[NUM_LEDS];
 
+// User range limits as last received (0 - 10000), restored after homing
+extern short rangeLimitUserMinInput;
+extern short rangeLimitUserMaxInput;
+
 // Configuration and connection functions
 void initializeConfiguration();
-bool checkForConfigMode();
 void connectToWiFi();
 void connectToWebSocketServer();
 
+// Runtime settings cache
+void loadRuntimeSettings();
+void applyStoredRangeLimits();
+void markSettingsChanged();
+void writeBackSettings();
+void flushSettings();
+
 // LED control functions
 void initializeLED();
 void setLEDColor(CRGB color);
 void updateLED();
 void setLEDStatus(LEDStatus status);
 
-// Configuration menu functions
+// Configuration menu functions. The console is opened with a 'c' line on
+// the T-Code serial port and takes over the serial input until it closes,
+// handleConfigMenu() runs it in place during setup. Its output is queued,
+// drainConsoleOutput() sends what the UART has room for.
+void openConfigConsole();
+void closeConfigConsole();
+bool configConsoleActive();
+void pollConfigConsole();
+void drainConsoleOutput();
 void handleConfigMenu();
 bool isValidWebSocketAddress(String address);
 
@@ -0,0 +1,175 @@
+#include "ControllerServer.h"
+#include "Configuration.h"
+
+WiFiServer* controllerServer = nullptr;
+
+struct ControllerClient {
+  WiFiClient connection;
+  uint8_t frame[CONTROLLER_FRAME_SIZE];
+  size_t received;
+  uint16_t frameLength;
+  bool active;
+};
+
+ControllerClient controllers[CONTROLLER_MAX_CLIENTS];
+
+struct ControllerResponse {
+  uint8_t length;
+  uint8_t data[CONTROLLER_RESPONSE_SIZE];
+};
+
+QueueHandle_t controllerResponseQueue;
+const char controllerResponseQueueSize = 16;
+
+portMUX_TYPE controlMux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t sourcePriority[COMMAND_SOURCES];
+uint8_t appPriority = DEFAULT_SOURCE_PRIORITY;
+uint8_t serialPriority = DEFAULT_SOURCE_PRIORITY;
+uint8_t controllerPriority = DEFAULT_SOURCE_PRIORITY;
+int16_t controlOwner = -1;
+unsigned long controlLastMs = 0;
+
+
+bool acquireMotionControl(uint8_t source) {
+  if (source >= COMMAND_SOURCES)
+    return false;
+  unsigned long now = millis();
+  bool granted;
+  portENTER_CRITICAL(&controlMux);
+  granted = controlOwner < 0
+      || controlOwner == source
+      || now - controlLastMs >= CONTROL_HOLD_MS
+      || sourcePriority[source] > sourcePriority[controlOwner];
+  if (granted) {
+    controlOwner = source;
+    controlLastMs = now;
+  }
+  portEXIT_CRITICAL(&controlMux);
+  return granted;
+}
+
+
+void releaseMotionControl(uint8_t source) {
+  portENTER_CRITICAL(&controlMux);
+  if (controlOwner == source)
+    controlOwner = -1;
+  portEXIT_CRITICAL(&controlMux);
+}
+
+
+uint8_t configuredPriority(uint8_t source) {
+  if (source == SOURCE_APP)
+    return appPriority;
+  if (source == SOURCE_SERIAL)
+    return serialPriority;
+  return controllerPriority;
+}
+
+
+// A client can give way to others, but never claim more than it is given
+void setSourcePriority(uint8_t source, uint8_t priority) {
+  if (source < COMMAND_SOURCES)
+    sourcePriority[source] = min(priority, configuredPriority(source));
+}
+
+
+void applyConfiguredPriorities() {
+  for (uint8_t i = 0; i < COMMAND_SOURCES; i++)
+    sourcePriority[i] = configuredPriority(i);
+}
+
+
+// Queued for the server task, which owns the client sockets
+void controllerBroadcast(const uint8_t* message, size_t length) {
+  if (controllerServer == nullptr || length > CONTROLLER_RESPONSE_SIZE)
+    return;
+  ControllerResponse response;
+  response.length = length;
+  memcpy(response.data, message, length);
+  xQueueSend(controllerResponseQueue, &response, 0);
+}
+
+
+void readControllerFrames(uint8_t index) {
+  ControllerClient* client = &controllers[index];
+  while (client->connection.available()) {
+    uint8_t received = client->connection.read();
+    if (client->received < 2) {
+      ((uint8_t*)&client->frameLength)[client->received++] = received;
+      continue;
+    }
+    if (client->frameLength <= CONTROLLER_FRAME_SIZE)
+      client->frame[client->received - 2] = received;
+    client->received++;
+    if (client->received - 2 < client->frameLength)
+      continue;
+    if (client->frameLength == 0 || client->frameLength > CONTROLLER_FRAME_SIZE)
+      Serial.println("ERROR: Controller frame too large.");
+    else
+      handleCommand(client->frame, client->frameLength, SOURCE_CONTROLLER + index);
+    client->received = 0;
+  }
+}
+
+
+void controllerServerTask(void *parameter) {
+  while (true) {
+    WiFiClient incoming = controllerServer->available();
+    if (incoming) {
+      int8_t slot = -1;
+      for (uint8_t i = 0; i < CONTROLLER_MAX_CLIENTS; i++) {
+        if (!controllers[i].connection.connected()) {
+          slot = i;
+          break;
+        }
+      }
+      if (slot < 0) {
+        incoming.stop();
+      } else {
+        controllers[slot].connection = incoming;
+        controllers[slot].connection.setNoDelay(true);
+        controllers[slot].received = 0;
+        controllers[slot].active = true;
+        setSourcePriority(SOURCE_CONTROLLER + slot, controllerPriority);
+        Serial.println("Controller connected: " + incoming.remoteIP().toString());
+      }
+    }
+
+    for (uint8_t i = 0; i < CONTROLLER_MAX_CLIENTS; i++) {
+      if (controllers[i].connection.connected()) {
+        readControllerFrames(i);
+      } else if (controllers[i].active) {
+        controllers[i].active = false;
+        controllers[i].connection.stop();
+        releaseMotionControl(SOURCE_CONTROLLER + i);
+        Serial.println("Controller disconnected.");
+      }
+    }
+
+    ControllerResponse response;
+    while (xQueueReceive(controllerResponseQueue, &response, 0)) {
+      uint16_t length = response.length;
+      for (uint8_t i = 0; i < CONTROLLER_MAX_CLIENTS; i++) {
+        if (!controllers[i].connection.connected())
+          continue;
+        controllers[i].connection.write((const uint8_t*)&length, 2);
+        controllers[i].connection.write(response.data, length);
+      }
+    }
+    vTaskDelay(1);
+  }
+}
+
+
+void initializeControllerServer() {
+  applyConfiguredPriorities();
+  uint16_t port = preferences.getUShort("server_port", 0);
+  if (port == 0)
+    return;
+  controllerResponseQueue = xQueueCreate(controllerResponseQueueSize, sizeof(ControllerResponse));
+  controllerServer = new WiFiServer(port, CONTROLLER_MAX_CLIENTS);
+  controllerServer->begin();
+  controllerServer->setNoDelay(true);
+  xTaskCreatePinnedToCore(controllerServerTask, "controllers", 4096, NULL, 1, NULL, 0);
+  Serial.println("Controller server listening on port " + String(port));
+}
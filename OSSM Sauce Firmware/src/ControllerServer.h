@@ -0,0 +1,53 @@
+#ifndef CONTROLLER_SERVER_H
+#define CONTROLLER_SERVER_H
+
+#include <Arduino.h>
+
+// Optional TCP server so controllers can drive the device directly instead
+// of through the app. Each frame is a u16 little-endian length followed by
+// one command packet, the same packets the app sends over the websocket.
+// Responses are broadcast to every controller in the same framing.
+// Enabled by setting a server port in the configuration menu.
+#define CONTROLLER_MAX_CLIENTS 4
+#define CONTROLLER_FRAME_SIZE 640
+#define CONTROLLER_RESPONSE_SIZE 16
+
+// Motion is arbitrated between command sources. A source keeps control
+// while it sends motion commands at least every CONTROL_HOLD_MS, a higher
+// priority source takes over at once. Priorities are device configuration,
+// set per kind of source in the configuration console and defaulting to
+// DEFAULT_SOURCE_PRIORITY. CONNECTION [u8 priority] can only lower the
+// sender's priority below the configured one.
+#define CONTROL_HOLD_MS 2000
+#define DEFAULT_SOURCE_PRIORITY 1
+
+enum CommandSource:uint8_t {
+  SOURCE_APP,
+  SOURCE_SERIAL,
+  SOURCE_CONTROLLER  // Controller client n is SOURCE_CONTROLLER + n
+};
+
+#define COMMAND_SOURCES (SOURCE_CONTROLLER + CONTROLLER_MAX_CLIENTS)
+
+// Configured priorities, every controller client shares one
+extern uint8_t appPriority;
+extern uint8_t serialPriority;
+extern uint8_t controllerPriority;
+
+// Implemented in main.cpp, decodes one command packet
+void handleCommand(uint8_t* message, size_t length, uint8_t source);
+
+void initializeControllerServer();
+
+void controllerBroadcast(const uint8_t* message, size_t length);
+
+bool acquireMotionControl(uint8_t source);
+
+void releaseMotionControl(uint8_t source);
+
+void setSourcePriority(uint8_t source, uint8_t priority);
+
+// Resets every source to its configured priority
+void applyConfiguredPriorities();
+
+#endif
@@ -0,0 +1,115 @@
+#include "EmergencyStop.h"
+#include "MotorMovement.h"
+#include "hal/gpio_ll.h"
+#include "esp_timer.h"
+
+volatile bool estopLatched = false;
+volatile bool estopPending = false;
+volatile bool estopStepsHalted = false;
+volatile uint32_t estopTriggerUs;
+volatile uint32_t estopLatencyUs = 0;
+uint32_t estopWorstLatencyUs = 0;
+TaskHandle_t estopTaskHandle = NULL;
+
+
+// Only IRAM code and inlined register access, digitalWrite and micros are
+// in flash. esp_timer is the clock micros reads, so latencies compare.
+void IRAM_ATTR triggerEmergencyStop() {
+  gpio_ll_set_level(&GPIO, (gpio_num_t)motorEnablePin, 1);
+  if (estopLatched)
+    return;
+  estopTriggerUs = esp_timer_get_time();
+  estopStepsHalted = false;
+  estopLatched = true;
+  estopPending = true;
+  if (estopTaskHandle == NULL)
+    return;  // Before initializeEmergencyStop the loop halts on its own
+  if (xPortInIsrContext()) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(estopTaskHandle, &woken);
+    if (woken)
+      portYIELD_FROM_ISR();
+  } else {
+    xTaskNotifyGive(estopTaskHandle);
+  }
+}
+
+
+// Highest priority on the motion core, so step generation halts as soon as
+// the trigger returns instead of whenever the loop gets back around
+void emergencyStopTask(void *parameter) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    stepper->forceStop();
+    estopLatencyUs = micros() - estopTriggerUs;
+    estopStepsHalted = true;
+  }
+}
+
+
+void IRAM_ATTR onEmergencyStopPin(void *arg) {
+  triggerEmergencyStop();
+}
+
+
+bool emergencyStopInputActive() {
+#if ESTOP_INPUT == ESTOP_INPUT_NORMALLY_OPEN
+  return digitalRead(motorStopPin) == LOW;
+#elif ESTOP_INPUT == ESTOP_INPUT_NORMALLY_CLOSED
+  return digitalRead(motorStopPin) == HIGH;
+#else
+  return false;
+#endif
+}
+
+
+void initializeEmergencyStop() {
+  xTaskCreatePinnedToCore(emergencyStopTask, "estop", 2048, NULL, configMAX_PRIORITIES - 1, &estopTaskHandle, 1);
+#if ESTOP_INPUT != ESTOP_INPUT_NONE
+  pinMode(motorStopPin, INPUT_PULLUP);
+  gpio_int_type_t edge = (ESTOP_INPUT == ESTOP_INPUT_NORMALLY_OPEN) ? GPIO_INTR_NEGEDGE : GPIO_INTR_POSEDGE;
+  attachIramInterrupt(motorStopPin, onEmergencyStopPin, edge);
+  if (emergencyStopInputActive())
+    triggerEmergencyStop();
+#endif
+}
+
+
+bool emergencyStopLatched() {
+  return estopLatched;
+}
+
+
+bool emergencyStopPending() {
+  if (!estopPending)
+    return false;
+  estopPending = false;
+  return true;
+}
+
+
+void emergencyStopHalted() {
+  if (!estopStepsHalted)
+    estopLatencyUs = micros() - estopTriggerUs;
+  estopWorstLatencyUs = max(estopWorstLatencyUs, estopLatencyUs);
+  Serial.println("EMERGENCY STOP: halted in " + String(estopLatencyUs) + " us, worst "
+      + String(estopWorstLatencyUs) + " us");
+}
+
+
+int32_t getEmergencyStopResponse() {
+  return estopLatched ? (int32_t)estopLatencyUs : -1;
+}
+
+
+bool clearEmergencyStop() {
+  if (emergencyStopInputActive()) {
+    Serial.println("ERROR: Emergency stop input still active.");
+    return false;
+  }
+  estopLatched = false;
+  estopPending = false;
+  digitalWrite(motorEnablePin, LOW);
+  Serial.println("Emergency stop cleared.");
+  return true;
+}
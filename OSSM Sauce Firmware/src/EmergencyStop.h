@@ -0,0 +1,59 @@
+#ifndef EMERGENCY_STOP_H
+#define EMERGENCY_STOP_H
+
+#include <Arduino.h>
+
+// Emergency stop from motorStopPin or the ESTOP command. The trigger
+// disables the motor driver at once, from the pin interrupt or the task
+// that decoded the command, and notifies a task at the highest priority on
+// the motion core that halts step generation with forceStop. The next loop
+// pass flushes every queue and latches the fault. Until ESTOP [0] clears
+// it, motion commands are ignored. Clearing re-enables the driver and
+// recalibrates, since the rail may have moved while unpowered.
+//
+// Worst case latency, from the pin edge:
+//   driver disabled  GPIO interrupt latency, a few us even during a flash
+//                    write. The pin handler is registered with
+//                    ESP_INTR_FLAG_IRAM and only runs IRAM code, a GPIO
+//                    register write and esp_timer_get_time.
+//   steps halted     interrupt latency plus one context switch, tens of us.
+//                    The task runs from flash, so an NVS write in progress
+//                    (writeBackSettings, the config console) delays it by
+//                    the write, up to a sector erase of roughly 50 ms.
+//                    Loop work such as pollSerial or moveStart's queue
+//                    wait does not delay it.
+// From the ESTOP command add the websocket or controller task's decode
+// time. The time to the halt is measured on every stop and reported in us
+// as the ESTOP response value, -1 once cleared. The worst case since boot
+// is printed with it.
+//
+// The pin is armed after boot homing. Select the wiring with
+// -D ESTOP_INPUT=ESTOP_INPUT_<TYPE>, a normally closed switch to ground
+// also stops on a broken wire.
+#define ESTOP_INPUT_NONE            0
+#define ESTOP_INPUT_NORMALLY_OPEN   1
+#define ESTOP_INPUT_NORMALLY_CLOSED 2
+
+#ifndef ESTOP_INPUT
+#define ESTOP_INPUT ESTOP_INPUT_NONE
+#endif
+
+void initializeEmergencyStop();
+
+// Safe to call from an interrupt or any task
+void triggerEmergencyStop();
+
+bool emergencyStopLatched();
+
+// True once per trigger, the caller halts motion and then calls
+// emergencyStopHalted to take the latency measurement
+bool emergencyStopPending();
+
+void emergencyStopHalted();
+
+int32_t getEmergencyStopResponse();
+
+// False while the stop input is still active
+bool clearEmergencyStop();
+
+#endif
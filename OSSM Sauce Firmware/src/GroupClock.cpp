@@ -0,0 +1,100 @@
+#include "GroupClock.h"
+#include "ControllerServer.h"
+
+struct ScheduledCommand {
+  bool pending;
+  uint32_t executeAtMs;
+  uint8_t source;
+  uint8_t length;
+  uint8_t data[SCHEDULED_COMMAND_SIZE];
+};
+
+ScheduledCommand scheduledCommands[SCHEDULED_COMMANDS];
+portMUX_TYPE scheduleMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool groupClockSynced = false;
+int32_t groupClockOffsetMs = 0;
+
+bool runningScheduledCommand = false;
+uint32_t scheduledLateMs = 0;
+
+
+uint32_t groupNowMs() {
+  return millis() + groupClockOffsetMs;
+}
+
+
+int32_t syncGroupClock(uint32_t groupTimeMs) {
+  int32_t phaseErrorMs = groupClockSynced ? (int32_t)(groupTimeMs - groupNowMs()) : 0;
+  groupClockOffsetMs = groupTimeMs - millis();
+  groupClockSynced = true;
+  return phaseErrorMs;
+}
+
+
+bool scheduleCommand(const uint8_t* packet, size_t length, uint32_t executeAtMs, uint8_t source) {
+  if (length == 0 || length > SCHEDULED_COMMAND_SIZE) {
+    Serial.println("ERROR: Scheduled command too large.");
+    return false;
+  }
+  bool stored = false;
+  portENTER_CRITICAL(&scheduleMux);
+  for (uint8_t i = 0; i < SCHEDULED_COMMANDS; i++) {
+    ScheduledCommand* slot = &scheduledCommands[i];
+    if (slot->pending)
+      continue;
+    slot->executeAtMs = groupClockSynced ? executeAtMs : groupNowMs();
+    slot->source = source;
+    slot->length = length;
+    memcpy(slot->data, packet, length);
+    slot->pending = true;
+    stored = true;
+    break;
+  }
+  portEXIT_CRITICAL(&scheduleMux);
+  if (!stored)
+    Serial.println("ERROR: Schedule full, command dropped.");
+  return stored;
+}
+
+
+void clearScheduledCommands() {
+  portENTER_CRITICAL(&scheduleMux);
+  for (uint8_t i = 0; i < SCHEDULED_COMMANDS; i++)
+    scheduledCommands[i].pending = false;
+  portEXIT_CRITICAL(&scheduleMux);
+}
+
+
+// Runs due commands earliest first
+void runScheduledCommands() {
+  while (true) {
+    ScheduledCommand command;
+    int32_t lateMs = -1;
+    uint32_t now = groupNowMs();
+    portENTER_CRITICAL(&scheduleMux);
+    int8_t due = -1;
+    for (uint8_t i = 0; i < SCHEDULED_COMMANDS; i++) {
+      if (!scheduledCommands[i].pending)
+        continue;
+      int32_t slotLateMs = (int32_t)(now - scheduledCommands[i].executeAtMs);
+      if (slotLateMs > lateMs) {
+        lateMs = slotLateMs;
+        due = i;
+      }
+    }
+    if (due >= 0) {
+      command = scheduledCommands[due];
+      scheduledCommands[due].pending = false;
+    }
+    portEXIT_CRITICAL(&scheduleMux);
+    if (due < 0)
+      return;
+
+    runningScheduledCommand = true;
+    scheduledLateMs = lateMs;
+    handleCommand(command.data, command.length, command.source);
+    runningScheduledCommand = false;
+    scheduledLateMs = 0;
+  }
+}
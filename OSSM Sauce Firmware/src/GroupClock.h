@@ -0,0 +1,35 @@
+#ifndef GROUP_CLOCK_H
+#define GROUP_CLOCK_H
+
+#include <Arduino.h>
+
+// Shared clock for playing one script on several devices in lockstep. The
+// app keeps each device's group clock in step with CLOCK_SYNC [u32 group ms],
+// sending its own time plus half the measured round trip. The response value
+// is the phase error, how far the device clock had drifted from the group
+// clock in ms before the correction.
+//
+// SCHEDULE [u32 group ms][packet] runs the wrapped command once the group
+// clock reaches that time, so PLAY, PAUSE and SEEK take effect at the same
+// instant on every device. Before the first CLOCK_SYNC, or when the time has
+// already passed, the command runs on the next loop.
+#define SCHEDULED_COMMANDS 8
+#define SCHEDULED_COMMAND_SIZE 32
+
+// Set while runScheduledCommands decodes a command, how far past its
+// scheduled time it runs
+extern bool runningScheduledCommand;
+extern uint32_t scheduledLateMs;
+
+uint32_t groupNowMs();
+
+// Returns the phase error, 0 on the first sync
+int32_t syncGroupClock(uint32_t groupTimeMs);
+
+bool scheduleCommand(const uint8_t* packet, size_t length, uint32_t executeAtMs, uint8_t source);
+
+void clearScheduledCommands();
+
+void runScheduledCommands();
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef MOTION_MATH_H
+#define MOTION_MATH_H
+
+#include <Arduino.h>
+
+// Numeric policy for the stroke math (interpolate, getMoveBaseSpeedHz and
+// processStroke). Select with -D MOTION_MATH_POLICY=MOTION_MATH_<TYPE>.
+// Build with -D MOTION_MATH_BENCHMARK to print accuracy and timing of every
+// policy against the double reference at boot.
+//
+// Max curve error against double (all TransType x EaseType, 1001 weights):
+//   FLOAT  2.2e-6
+//   FIXED  2.6e-4, except TRANS_CIRC at 7.8e-3 where sqrt() near zero
+//          amplifies the Q16.16 step. Speeds are clamped to 1% anyway.
+#define MOTION_MATH_DOUBLE 0
+#define MOTION_MATH_FLOAT  1
+#define MOTION_MATH_FIXED  2
+
+#ifndef MOTION_MATH_POLICY
+#define MOTION_MATH_POLICY MOTION_MATH_FLOAT
+#endif
+
+
+// Reference implementation, doubles are software emulated on the ESP32
+struct DoubleMath {
+  typedef double Value;
+  typedef double Ratio;
+
+  static const char* name() { return "double"; }
+  static Ratio reciprocal(uint32_t duration) { return 1.0 / duration; }
+  static Value ratio(uint32_t elapsed, Ratio reciprocal) { return elapsed * reciprocal; }
+  static Value one() { return 1.0; }
+  static Value fromFloat(float value) { return value; }
+  static float toFloat(Value value) { return value; }
+  static Value mul(Value a, Value b) { return a * b; }
+  static Value abs(Value value) { return fabs(value); }
+  static Value sinQuarter(Value x) { return sin(x * PI * 0.5); }
+  static Value cosQuarter(Value x) { return cos(x * PI * 0.5); }
+  static Value sqrt(Value x) { return ::sqrt(x); }
+  static Value exp2(Value x) { return pow(2, x); }
+
+  static uint32_t scaleHz(uint32_t baseHz, Value curve) {
+    return round(baseHz * max(curve, 0.01));
+  }
+
+  static uint32_t speedHz(uint32_t distance, uint32_t durationMs, float factor) {
+    return round(distance / (durationMs * 0.001) * factor);
+  }
+};
+
+
+// Single precision, runs on the ESP32 FPU
+struct FloatMath {
+  typedef float Value;
+  typedef float Ratio;
+
+  static const char* name() { return "float"; }
+  static Ratio reciprocal(uint32_t duration) { return 1.0f / duration; }
+  static Value ratio(uint32_t elapsed, Ratio reciprocal) { return elapsed * reciprocal; }
+  static Value one() { return 1.0f; }
+  static Value fromFloat(float value) { return value; }
+  static float toFloat(Value value) { return value; }
+  static Value mul(Value a, Value b) { return a * b; }
+  static Value abs(Value value) { return fabsf(value); }
+  static Value sinQuarter(Value x) { return sinf(x * (float)HALF_PI); }
+  static Value cosQuarter(Value x) { return cosf(x * (float)HALF_PI); }
+  static Value sqrt(Value x) { return sqrtf(x); }
+  static Value exp2(Value x) { return exp2f(x); }
+
+  static uint32_t scaleHz(uint32_t baseHz, Value curve) {
+    return lroundf(baseHz * max(curve, 0.01f));
+  }
+
+  static uint32_t speedHz(uint32_t distance, uint32_t durationMs, float factor) {
+    return lroundf(distance * 1000.0f / durationMs * factor);
+  }
+};
+
+
+// Q16.16 fixed point, integer only on the motion path
+constexpr int32_t q16(double value) {
+  return (int32_t)(value * 65536.0 + (value >= 0 ? 0.5 : -0.5));
+}
+
+struct FixedMath {
+  typedef int32_t Value;
+  typedef uint32_t Ratio;  // Q0.32 reciprocal
+
+  static const char* name() { return "Q16.16"; }
+
+  static Ratio reciprocal(uint32_t duration) {
+    return (duration <= 1) ? UINT32_MAX : (uint32_t)(0x100000000ULL / duration);
+  }
+
+  static Value ratio(uint32_t elapsed, Ratio reciprocal) {
+    return (Value)(((uint64_t)elapsed * reciprocal) >> 16);
+  }
+
+  static Value one() { return 1 << 16; }
+  static Value fromFloat(float value) { return (Value)lroundf(value * 65536.0f); }
+  static float toFloat(Value value) { return value * (1.0f / 65536.0f); }
+  static Value mul(Value a, Value b) { return (Value)(((int64_t)a * b) >> 16); }
+  static Value abs(Value value) { return (value < 0) ? -value : value; }
+
+  // sin(x * PI / 2) for x in [0, 1], Taylor series to x^9
+  static Value sinQuarter(Value x) {
+    Value x2 = mul(x, x);
+    Value poly = q16(0.0046817541) - mul(x2, q16(0.0001604411));
+    poly = q16(0.0796926262) - mul(x2, poly);
+    poly = q16(0.6459640975) - mul(x2, poly);
+    poly = q16(1.5707963268) - mul(x2, poly);
+    return mul(x, poly);
+  }
+
+  static Value cosQuarter(Value x) { return sinQuarter(one() - x); }
+
+  static Value sqrt(Value x) {
+    if (x <= 0)
+      return 0;
+    uint64_t value = (uint64_t)x << 16;
+    uint64_t result = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > value)
+      bit >>= 2;
+    while (bit != 0) {
+      if (value >= result + bit) {
+        value -= result + bit;
+        result = (result >> 1) + bit;
+      } else {
+        result >>= 1;
+      }
+      bit >>= 2;
+    }
+    return (Value)result;
+  }
+
+  // 2^x, integer part by shifting, fraction by Taylor series to f^6
+  static Value exp2(Value x) {
+    int32_t whole = x >> 16;
+    Value fraction = x & 0xFFFF;
+    Value poly = q16(0.0013333558) + mul(fraction, q16(0.0001540353));
+    poly = q16(0.0096181291) + mul(fraction, poly);
+    poly = q16(0.0555041087) + mul(fraction, poly);
+    poly = q16(0.2402265070) + mul(fraction, poly);
+    poly = q16(0.6931471806) + mul(fraction, poly);
+    poly = one() + mul(fraction, poly);
+    if (whole >= 0)
+      return (whole > 14) ? INT32_MAX : poly << whole;
+    return (whole < -31) ? 0 : poly >> -whole;
+  }
+
+  static uint32_t scaleHz(uint32_t baseHz, Value curve) {
+    return (uint32_t)(((uint64_t)baseHz * max(curve, q16(0.01)) + 0x8000) >> 16);
+  }
+
+  static uint32_t speedHz(uint32_t distance, uint32_t durationMs, float factor) {
+    uint64_t speed = (uint64_t)distance * 1000 * fromFloat(factor) / durationMs;
+    return (uint32_t)((speed + 0x8000) >> 16);
+  }
+};
+
+
+#if MOTION_MATH_POLICY == MOTION_MATH_DOUBLE
+typedef DoubleMath MotionMath;
+#elif MOTION_MATH_POLICY == MOTION_MATH_FIXED
+typedef FixedMath MotionMath;
+#else
+typedef FloatMath MotionMath;
+#endif
+
+#endif
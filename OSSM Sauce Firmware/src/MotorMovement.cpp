@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include "MotorMovement.h"
 #include "Configuration.h"
+#include "Oscillator.h"
 
 float powerAvgRangeMultiplier = 1.5; // Raise to decrease, or lower to increase sensitivity of sensorless homing
 const int outliersSampleSize = 10;
@@ -18,6 +19,8 @@ int rangeLimitUserMax;
 
 uint32_t globalSpeedLimitHz = 20000;
 uint32_t globalAcceleration = 20000;
+uint32_t tunedSpeedLimitHz = 0;
+uint32_t tunedAcceleration = 0;
 bool applyAcceleration;
 
 MovementMode movementMode;
@@ -32,6 +35,16 @@ uint32_t homingSpeedHz = 1000;
 
 Vibration vibration;
 
+RecalibrateStage recalibrateStage = RECALIBRATE_IDLE;
+AutoTuneStage autoTuneStage = AUTOTUNE_IDLE;
+
+
+void attachIramInterrupt(uint8_t pin, gpio_isr_t handler, gpio_int_type_t edge) {
+  gpio_install_isr_service(ESP_INTR_FLAG_IRAM);  // Already installed after the first pin
+  gpio_set_intr_type((gpio_num_t)pin, edge);
+  gpio_isr_handler_add((gpio_num_t)pin, handler, NULL);
+}
+
 
 void initializeMotor() {
   engine.init();
@@ -63,7 +76,7 @@ float powerEMASlowDoubleSmooth;
 bool powerSpikeTriggered;
 float deltaArray[deltaSampleLength];
 void getPowerReading(bool takeDeltaSample = false, int deltaSampleIndex = 0) {
-  float sum;
+  float sum = 0;
   for (int i = 0; i < powerSampleSize; i++)
     sum += analogRead(powerSensorPin);
   float sampleAverage = sum / powerSampleSize;
@@ -84,7 +97,8 @@ void getPowerReading(bool takeDeltaSample = false, int deltaSampleIndex = 0) {
 }
 
 
-void sensorlessHoming() {
+// Measures the idle spread of the power reading that spikes are judged against
+void measurePowerVariance() {
 // Root mean square could be a better way to determine averages
   Serial.println("");
   Serial.println("Scanning power consumption variance...");
@@ -142,41 +156,175 @@ void sensorlessHoming() {
   // Get average range of samples
   powerAvgRange = outliersAvgHigh - outliersAvgLow;
   powerAvgRange *= powerAvgRangeMultiplier;
+}
 
-  Serial.println("");
-  Serial.println("Beginning sensorless homing...");
-  Serial.print("powerAvgRangeMultiplier: ");
-  Serial.println(powerAvgRangeMultiplier);
-
-  stepper->setAutoEnable(true);
 
-  // Find physical maximum limit
+// Runs until the power spikes, returns the end position backed off 50 steps
+int seekPowerSpike(bool forward) {
   powerEMAFast = powerEMASlowDoubleSmooth;
   powerSpikeTriggered = false;
-  int limitPhysicalMax;
 
-  stepper->runForward();
+  if (forward)
+    stepper->runForward();
+  else
+    stepper->runBackward();
   while (!powerSpikeTriggered) {
     getPowerReading();
   }
   stepper->forceStop();
-  stepper->move(-50);
-  limitPhysicalMax = stepper->getCurrentPosition();
+  stepper->move(forward ? -50 : 50);
+  return stepper->getCurrentPosition();
+}
+
+
+void sensorlessHoming() {
+  measurePowerVariance();
+
+  Serial.println("");
+  Serial.println("Beginning sensorless homing...");
+  Serial.print("powerAvgRangeMultiplier: ");
+  Serial.println(powerAvgRangeMultiplier);
+
+  stepper->setAutoEnable(true);
+
+  // Find physical maximum limit
+  int limitPhysicalMax = seekPowerSpike(true);
 
   delay(300);
 
   // Find physical minimum limit
+  int limitPhysicalMin = seekPowerSpike(false);
+
+  delay(200);
+
+  // Lock motor movement
+  stepper->setAutoEnable(false);
+  digitalWrite(motorEnablePin, LOW);
+
+  setHardLimits(limitPhysicalMin, limitPhysicalMax);
+  stepper->moveTo(rangeLimitHardMin);
+}
+
+
+bool homingBySwitch = false;
+uint32_t railLengthSteps = 0;
+bool motorReversed = false;
+volatile bool limitSwitchArmed = false;  // Only while seeking the switch
+volatile bool limitSwitchLatched = false;
+volatile int32_t limitSwitchPosition;
+TaskHandle_t limitSwitchTaskHandle = NULL;
+
+// FastAccelStepper lives in flash, so the interrupt leaves the stepper to
+// limitSwitchTask and stays safe while an NVS write disables the cache
+void IRAM_ATTR onLimitSwitch(void *arg) {
+  if (!limitSwitchArmed)
+    return;
+  limitSwitchArmed = false;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(limitSwitchTaskHandle, &woken);
+  if (woken)
+    portYIELD_FROM_ISR();
+}
+
+
+// Just below the emergency stop on the motion core, the position is
+// latched before the loop sees the switch
+void limitSwitchTask(void *parameter) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    stepper->forceStop();
+    limitSwitchPosition = stepper->getCurrentPosition();
+    limitSwitchLatched = true;
+  }
+}
+
+
+void armLimitSwitch() {
+  limitSwitchLatched = false;
+  limitSwitchArmed = true;
+}
+
+
+void waitForStop() {
+  while (stepper->isRunning())
+    delay(1);
+}
+
+
+// Runs backward until the switch latches. Gives up past maxTravel steps,
+// or on a power spike when watchPower is set and the rail length unknown.
+bool touchLimitSwitch(uint32_t speedHz, int32_t maxTravel, bool watchPower) {
+  int32_t startPosition = stepper->getCurrentPosition();
+  armLimitSwitch();
   powerEMAFast = powerEMASlowDoubleSmooth;
   powerSpikeTriggered = false;
-  int limitPhysicalMin;
-
+  stepper->setSpeedInHz(speedHz);
   stepper->runBackward();
-  while (!powerSpikeTriggered) {
-    getPowerReading();
+  while (!limitSwitchLatched) {
+    if (watchPower)
+      getPowerReading();
+    if (powerSpikeTriggered || abs(stepper->getCurrentPosition() - startPosition) > maxTravel) {
+      limitSwitchArmed = false;
+      stepper->forceStop();
+      return false;
+    }
   }
   stepper->forceStop();
+  return true;
+}
+
+
+void limitSwitchHoming() {
+  pinMode(limitSwitchPin, INPUT_PULLUP);
+  if (limitSwitchTaskHandle == NULL)
+    xTaskCreatePinnedToCore(limitSwitchTask, "limit switch", 2048, NULL, configMAX_PRIORITIES - 2, &limitSwitchTaskHandle, 1);
+  attachIramInterrupt(limitSwitchPin, onLimitSwitch, GPIO_INTR_NEGEDGE);
+
+  // The far end is found the sensorless way, which also arms stall detection
+  bool findFarEnd = railLengthSteps == 0;
+  if (findFarEnd)
+    measurePowerVariance();
+
+  Serial.println("");
+  Serial.println("Beginning limit switch homing...");
+
+  stepper->setAcceleration(180000);
+  stepper->setAutoEnable(true);
+
+  int limitPhysicalMax;
+  if (findFarEnd) {
+    stepper->setSpeedInUs(1900);
+    limitPhysicalMax = seekPowerSpike(true);
+    delay(300);
+  }
+
+  if (digitalRead(limitSwitchPin) == LOW) {
+    stepper->setSpeedInHz(LIMIT_HOMING_SLOW_HZ);
+    stepper->move(LIMIT_HOMING_BACKOFF_STEPS);
+    waitForStop();
+  }
+
+  int32_t maxTravel = findFarEnd ? INT32_MAX : railLengthSteps * 1.5;
+  bool touched = touchLimitSwitch(LIMIT_HOMING_FAST_HZ, maxTravel, findFarEnd);
+  if (touched) {
+    stepper->setSpeedInHz(LIMIT_HOMING_SLOW_HZ);
+    stepper->move(LIMIT_HOMING_BACKOFF_STEPS);
+    waitForStop();
+    touched = touchLimitSwitch(LIMIT_HOMING_SLOW_HZ, LIMIT_HOMING_BACKOFF_STEPS * 2, findFarEnd);
+  }
+  if (!touched) {
+    Serial.println("ERROR: Limit switch not reached, falling back to sensorless homing.");
+    stepper->setAutoEnable(false);
+    digitalWrite(motorEnablePin, LOW);
+    delay(300);
+    sensorlessHoming();
+    return;
+  }
+
+  int limitPhysicalMin = limitSwitchPosition;
   stepper->move(50);
-  limitPhysicalMin = stepper->getCurrentPosition();
+  if (!findFarEnd)
+    limitPhysicalMax = limitPhysicalMin + railLengthSteps;
 
   delay(200);
 
@@ -184,10 +332,15 @@ void sensorlessHoming() {
   stepper->setAutoEnable(false);
   digitalWrite(motorEnablePin, LOW);
 
-  // Set hard limits
+  setHardLimits(limitPhysicalMin, limitPhysicalMax);
+  stepper->moveTo(rangeLimitHardMin);
+}
+
+
+void setHardLimits(int limitPhysicalMin, int limitPhysicalMax) {
   float hardLimitBuffer = abs(limitPhysicalMax - limitPhysicalMin) * 0.06;
 
-  if (preferences.getBool("motor_reversed", false)) {
+  if (motorReversed) {
     rangeLimitHardMin = limitPhysicalMax - hardLimitBuffer;
     rangeLimitHardMax = limitPhysicalMin + hardLimitBuffer;
   } else {
@@ -198,8 +351,6 @@ void sensorlessHoming() {
   rangeLimitUserMin = rangeLimitHardMin;
   rangeLimitUserMax = rangeLimitHardMax;
 
-  stepper->moveTo(rangeLimitHardMin);
-
   Serial.println("");
   Serial.print("MINIMUM RANGE LIMIT: ");
   Serial.println(rangeLimitHardMin);
@@ -212,71 +363,377 @@ void sensorlessHoming() {
 }
 
 
-double exponentEasing(double weight, EaseType easing, int exponent) {
+uint32_t stallLastSampleUs;
+uint32_t stallMotionStartMs;
+bool stallMotorDriven;
+uint8_t stallSamplesOver;
+
+bool monitorStall(bool motorDriven) {
+#if STALL_TRIGGER_MULTIPLIER > 0
+  uint32_t now = micros();
+  if (now - stallLastSampleUs < STALL_SAMPLE_INTERVAL_US)
+    return false;
+  stallLastSampleUs = now;
+
+  // Nothing to judge against when homing skipped the variance scan
+  if (!motorDriven || powerAvgRange <= 0) {
+    stallMotorDriven = false;
+    return false;
+  }
+  getPowerReading();
+  if (!stallMotorDriven) {
+    // Idle draw is far below running draw, start the averages from here
+    stallMotorDriven = true;
+    stallMotionStartMs = millis();
+    stallSamplesOver = 0;
+    powerEMASlow = powerEMAFast;
+    powerEMASlowSmooth = powerEMAFast;
+    powerEMASlowDoubleSmooth = powerEMAFast;
+  }
+  if (millis() - stallMotionStartMs < STALL_SETTLE_MS)
+    return false;
+
+  if (powerEMAFast > powerEMASlowDoubleSmooth + powerAvgRange * STALL_TRIGGER_MULTIPLIER) {
+    if (++stallSamplesOver >= STALL_TRIGGER_SAMPLES) {
+      stallMotorDriven = false;
+      Serial.println("ERROR: Stall detected at position " + String(stepper->getCurrentPosition()));
+      return true;
+    }
+  } else {
+    stallSamplesOver = 0;
+  }
+#endif
+  return false;
+}
+
+
+// Same sequence as sensorlessHoming, one power reading per loop. The
+// trigger range measured at boot is kept.
+const int recalibrateSettleSamples = 1200;
+const uint32_t recalibrateReverseDelayMs = 300;
+uint32_t recalibrateStageMs;
+int recalibrateSamples;
+int32_t recalibrateStartPosition;
+int recalibrateLimitMax;
+
+void setRecalibrateStage(RecalibrateStage stage) {
+  recalibrateStage = stage;
+  recalibrateStageMs = millis();
+  recalibrateSamples = 0;
+  recalibrateStartPosition = stepper->getCurrentPosition();
+}
+
+
+void startRecalibration() {
+  stepper->forceStop();
+  stepper->setAcceleration(180000);
+  stepper->setSpeedInUs(1900);
+  getPowerReading();
+  powerEMASlow = powerEMAFast;
+  powerEMASlowSmooth = powerEMAFast;
+  powerEMASlowDoubleSmooth = powerEMAFast;
+  setRecalibrateStage(RECALIBRATE_SETTLE);
+  Serial.println("Recalibrating range limits...");
+}
+
+
+// A seek that travels twice the known range without reaching an end stop failed
+bool recalibrateOvertravel() {
+  int32_t travel = abs(stepper->getCurrentPosition() - recalibrateStartPosition);
+  return travel > abs(rangeLimitHardMax - rangeLimitHardMin) * 2;
+}
+
+
+bool processRecalibration() {
+  RecalibrateStage previousStage = recalibrateStage;
+  switch (recalibrateStage) {
+    case RECALIBRATE_SETTLE: {
+      if (stepper->isRunning())
+        break;
+      // A switch and a known rail length need no power readings
+      if (homingBySwitch && railLengthSteps) {
+        setRecalibrateStage(RECALIBRATE_SEEK_MIN);
+        break;
+      }
+      getPowerReading();
+      if (++recalibrateSamples < recalibrateSettleSamples)
+        break;
+      setRecalibrateStage(RECALIBRATE_SEEK_MAX);
+      powerEMAFast = powerEMASlowDoubleSmooth;
+      powerSpikeTriggered = false;
+      stepper->runForward();
+      break;
+    }
+
+    case RECALIBRATE_SEEK_MAX: {
+      getPowerReading();
+      if (!powerSpikeTriggered) {
+        if (recalibrateOvertravel())
+          setRecalibrateStage(RECALIBRATE_FAILED);
+        break;
+      }
+      stepper->forceStop();
+      stepper->move(-50);
+      recalibrateLimitMax = stepper->getCurrentPosition();
+      setRecalibrateStage(RECALIBRATE_SEEK_MIN);
+      break;
+    }
+
+    case RECALIBRATE_SEEK_MIN: {
+      if (recalibrateSamples == 0) {
+        if (millis() - recalibrateStageMs < recalibrateReverseDelayMs)
+          break;
+        recalibrateSamples = 1;
+        recalibrateStartPosition = stepper->getCurrentPosition();
+        powerEMAFast = powerEMASlowDoubleSmooth;
+        powerSpikeTriggered = false;
+        armLimitSwitch();
+        stepper->runBackward();
+        break;
+      }
+      if (!homingBySwitch)
+        getPowerReading();
+      if (homingBySwitch ? !limitSwitchLatched : !powerSpikeTriggered) {
+        if (recalibrateOvertravel())
+          setRecalibrateStage(RECALIBRATE_FAILED);
+        break;
+      }
+      stepper->forceStop();
+      stepper->move(50);
+      int limitPhysicalMin = homingBySwitch ? limitSwitchPosition : stepper->getCurrentPosition();
+      if (homingBySwitch && railLengthSteps)
+        recalibrateLimitMax = limitPhysicalMin + railLengthSteps;
+      setHardLimits(limitPhysicalMin, recalibrateLimitMax);
+      setRecalibrateStage(RECALIBRATE_DONE);
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  if (recalibrateStage == RECALIBRATE_FAILED && previousStage != RECALIBRATE_FAILED) {
+    limitSwitchArmed = false;
+    stepper->forceStop();
+    Serial.println("ERROR: Recalibration found no end stop, range limits unchanged.");
+  }
+  return recalibrateStage != previousStage;
+}
+
+
+const uint32_t autoTuneStartAcceleration = 10000;
+const uint32_t autoTuneMaxAcceleration = 1000000;
+const uint32_t autoTuneAccelerationSpeedHz = 8000;
+const uint32_t autoTuneStartSpeedHz = 2000;
+const uint32_t autoTuneMaxSpeedHz = 60000;
+const float autoTuneStep = 1.25;
+uint32_t autoTuneAcceleration;
+uint32_t autoTuneSpeedHz;
+uint32_t autoTunePassed;
+uint32_t autoTuneFoundAcceleration;
+uint8_t autoTuneStroke;
+bool autoTuneTowardMax = true;
+uint8_t autoTuneSamplesOver;
+bool autoTuneOnset;
+uint32_t autoTuneLastSampleUs;
+
+void startAutoTuneStroke() {
+  stepper->moveTo(autoTuneTowardMax ? rangeLimitUserMax : rangeLimitUserMin);
+  autoTuneTowardMax = !autoTuneTowardMax;
+}
+
+
+void startAutoTuneLevel() {
+  autoTuneStroke = 0;
+  autoTuneSamplesOver = 0;
+  autoTuneOnset = false;
+  stepper->setAcceleration(autoTuneAcceleration);
+  stepper->setSpeedInHz(autoTuneSpeedHz);
+  startAutoTuneStroke();
+}
+
+
+bool startAutoTune() {
+  if (powerAvgRange <= 0) {
+    autoTuneStage = AUTOTUNE_FAILED;
+    Serial.println("ERROR: Auto-tune needs the power variance scan of sensorless homing.");
+    return false;
+  }
+  stepper->forceStop();
+  getPowerReading();
+  powerEMASlow = powerEMAFast;
+  powerEMASlowSmooth = powerEMAFast;
+  powerEMASlowDoubleSmooth = powerEMAFast;
+  autoTuneStage = AUTOTUNE_ACCELERATION;
+  autoTuneAcceleration = autoTuneStartAcceleration;
+  autoTuneSpeedHz = autoTuneAccelerationSpeedHz;
+  autoTunePassed = 0;
+  startAutoTuneLevel();
+  Serial.println("Auto-tuning acceleration and speed limits...");
+  return true;
+}
+
+
+// Next level, or the end of the stage when this one showed a stall onset
+// or the next would pass the cap
+void finishAutoTuneLevel() {
+  bool lastLevel;
+  if (autoTuneStage == AUTOTUNE_ACCELERATION) {
+    if (!autoTuneOnset)
+      autoTunePassed = autoTuneAcceleration;
+    autoTuneAcceleration *= autoTuneStep;
+    lastLevel = autoTuneOnset || autoTuneAcceleration > autoTuneMaxAcceleration;
+    if (!lastLevel) {
+      startAutoTuneLevel();
+      return;
+    }
+    if (autoTunePassed == 0) {
+      autoTuneStage = AUTOTUNE_FAILED;
+      return;
+    }
+    autoTuneFoundAcceleration = autoTunePassed * AUTOTUNE_MARGIN;
+    Serial.println("Tuned acceleration: " + String(autoTuneFoundAcceleration));
+    autoTuneStage = AUTOTUNE_SPEED;
+    autoTuneAcceleration = autoTuneFoundAcceleration;
+    autoTuneSpeedHz = autoTuneStartSpeedHz;
+    autoTunePassed = 0;
+    startAutoTuneLevel();
+    return;
+  }
+
+  if (!autoTuneOnset)
+    autoTunePassed = autoTuneSpeedHz;
+  autoTuneSpeedHz *= autoTuneStep;
+  // Past the peak of a full range stroke at this acceleration the speed is never reached
+  uint32_t reachableHz = sqrt((float)autoTuneAcceleration * abs(rangeLimitUserMax - rangeLimitUserMin));
+  lastLevel = autoTuneOnset || autoTuneSpeedHz > min(autoTuneMaxSpeedHz, reachableHz);
+  if (!lastLevel) {
+    startAutoTuneLevel();
+    return;
+  }
+  if (autoTunePassed == 0) {
+    autoTuneStage = AUTOTUNE_FAILED;
+    return;
+  }
+  tunedAcceleration = autoTuneFoundAcceleration;
+  tunedSpeedLimitHz = autoTunePassed * AUTOTUNE_MARGIN;
+  Serial.println("Tuned speed limit: " + String(tunedSpeedLimitHz));
+  autoTuneStage = AUTOTUNE_DONE;
+}
+
+
+bool processAutoTune() {
+  AutoTuneStage previousStage = autoTuneStage;
+  if (autoTuneStage != AUTOTUNE_ACCELERATION && autoTuneStage != AUTOTUNE_SPEED)
+    return false;
+
+  uint32_t now = micros();
+  if (now - autoTuneLastSampleUs >= STALL_SAMPLE_INTERVAL_US) {
+    autoTuneLastSampleUs = now;
+    getPowerReading();
+    float onsetRange = powerAvgRange * STALL_TRIGGER_MULTIPLIER * AUTOTUNE_ONSET;
+    if (autoTuneStroke > 0 && powerEMAFast > powerEMASlowDoubleSmooth + onsetRange) {
+      if (++autoTuneSamplesOver >= STALL_TRIGGER_SAMPLES)
+        autoTuneOnset = true;
+    } else {
+      autoTuneSamplesOver = 0;
+    }
+  }
+
+  if (autoTuneOnset) {
+    stepper->stopMove();
+    finishAutoTuneLevel();
+  } else if (!stepper->isRunning()) {
+    if (++autoTuneStroke < AUTOTUNE_LEVEL_STROKES)
+      startAutoTuneStroke();
+    else
+      finishAutoTuneLevel();
+  }
+
+  if (autoTuneStage == AUTOTUNE_FAILED && previousStage != AUTOTUNE_FAILED)
+    Serial.println("ERROR: Auto-tune stalled at the first level, limits unchanged.");
+  return autoTuneStage != previousStage;
+}
+
+
+template <typename M>
+typename M::Value powi(typename M::Value base, int exponent) {
+  typename M::Value result = M::one();
+  for (int i = 0; i < exponent; i++)
+    result = M::mul(result, base);
+  return result;
+}
+
+
+template <typename M>
+typename M::Value exponentEasing(typename M::Value weight, EaseType easing, int exponent) {
   switch (easing) {
     case EASE_IN:
-      return pow(weight, exponent);
+      return powi<M>(weight, exponent);
     case EASE_OUT:
-      return pow(weight - 1, exponent);
+      return powi<M>(weight - M::one(), exponent);
     case EASE_IN_OUT:
-      return pow((1 - abs(2 * weight - 1)), exponent);
+      return powi<M>((M::one() - M::abs(2 * weight - M::one())), exponent);
     case EASE_OUT_IN:
-      return pow((1 - abs(2 * weight - 1)) - 1, exponent);
+      return powi<M>((M::one() - M::abs(2 * weight - M::one())) - M::one(), exponent);
     default:
       return 0;
   }
 }
 
 
-double interpolate(double weight, TransType transType, EaseType easeType) {
+template <typename M>
+typename M::Value interpolate(typename M::Value weight, TransType transType, EaseType easeType) {
+  typedef typename M::Value Value;
+  const Value one = M::one();
   switch (transType) {
     case TRANS_LINEAR:
-      return 1;
+      return one;
     
     case TRANS_SINE:
       switch (easeType) {
         case EASE_IN:
-          return 1 - cos(weight * PI * 0.5);
+          return one - M::cosQuarter(weight);
         case EASE_OUT:
-          return 1 - sin(weight * PI * 0.5);
+          return one - M::sinQuarter(weight);
         case EASE_IN_OUT:
-          return 1 - cos((1 - abs(2 * weight - 1)) * PI * 0.5);
+          return one - M::cosQuarter(one - M::abs(2 * weight - one));
         case EASE_OUT_IN:
-          return 1 - sin((1 - abs(2 * weight - 1)) * PI * 0.5);
+          return one - M::sinQuarter(one - M::abs(2 * weight - one));
       }
     
     case TRANS_CIRC:
       switch (easeType) {
         case EASE_IN:
-          return 1 - sqrt(1 - pow(weight, 2));
+          return one - M::sqrt(one - powi<M>(weight, 2));
         case EASE_OUT:
-          return 1 - sqrt(1 - pow(weight - 1, 2));
+          return one - M::sqrt(one - powi<M>(weight - one, 2));
         case EASE_IN_OUT:
-          return 1 - sqrt(1 - pow((1 - abs(2 * weight - 1)), 2));
+          return one - M::sqrt(one - powi<M>((one - M::abs(2 * weight - one)), 2));
         case EASE_OUT_IN:
-          return 1 - sqrt(1 - pow((1 - abs(2 * weight - 1)) - 1, 2));
+          return one - M::sqrt(one - powi<M>((one - M::abs(2 * weight - one)) - one, 2));
       }
     
     case TRANS_EXPO:
       switch (easeType) {
         case EASE_IN:
-          return pow(2, 10 * (weight - 1));
+          return M::exp2(10 * (weight - one));
         case EASE_OUT:
-          return pow(2, -10 * weight);
+          return M::exp2(-10 * weight);
         case EASE_IN_OUT:
-          return pow(2, 10 * ((1 - abs(2 * weight - 1)) - 1));
+          return M::exp2(10 * ((one - M::abs(2 * weight - one)) - one));
         case EASE_OUT_IN:
-          return pow(2, -10 * (1 - abs(2 * weight - 1)));
+          return M::exp2(-10 * (one - M::abs(2 * weight - one)));
       }
 
     case TRANS_QUAD:
-      return exponentEasing(weight, easeType, 2);
+      return exponentEasing<M>(weight, easeType, 2);
     case TRANS_CUBIC:
-      return abs(exponentEasing(weight, easeType, 3));
+      return M::abs(exponentEasing<M>(weight, easeType, 3));
     case TRANS_QUART:
-      return exponentEasing(weight, easeType, 4);
+      return exponentEasing<M>(weight, easeType, 4);
     case TRANS_QUINT:
-      return abs(exponentEasing(weight, easeType, 5));
+      return M::abs(exponentEasing<M>(weight, easeType, 5));
     
     default:
       return 0;
@@ -284,6 +741,9 @@ double interpolate(double weight, TransType transType, EaseType easeType) {
 }
 
 
+// Base speed multipliers per TransType to match traversal time with linear move
+const float transSpeedFactors[] = {1, 2.73, 4.46, 6.9, 2.98, 3.9, 4.85, 5.79};
+
 // Amplify base move speed to match traversal time with linear move
 uint32_t getMoveBaseSpeedHz(StrokeCommand stroke, uint32_t moveDuration, bool useFullUserRange) {
   int moveDelta;
@@ -291,25 +751,38 @@ uint32_t getMoveBaseSpeedHz(StrokeCommand stroke, uint32_t moveDuration, bool us
     moveDelta = rangeLimitUserMax - rangeLimitUserMin;
   else
     moveDelta = stroke.targetPosition - stepper->getCurrentPosition();
-  float linearMoveSpeed = abs(moveDelta) / (moveDuration * 0.001);
-  switch (stroke.transType) {
-    case TRANS_SINE:
-      return round(linearMoveSpeed * 2.73);
-    case TRANS_CIRC:
-      return round(linearMoveSpeed * 4.46);
-    case TRANS_EXPO:
-      return round(linearMoveSpeed * 6.9);
-    case TRANS_QUAD:
-      return round(linearMoveSpeed * 2.98);
-    case TRANS_CUBIC:
-      return round(linearMoveSpeed * 3.9);
-    case TRANS_QUART:
-      return round(linearMoveSpeed * 4.85);
-    case TRANS_QUINT:
-      return round(linearMoveSpeed * 5.79);
-    default:
-      return round(linearMoveSpeed);
-  }
+  float speedFactor = (stroke.transType <= TRANS_QUINT) ? transSpeedFactors[stroke.transType] : 1;
+  return MotionMath::speedHz(abs(moveDelta), max(moveDuration, (uint32_t)1), speedFactor);
+}
+
+
+// TRANS_BEZIER strokes follow a cubic Bezier over normalized time with the
+// end points fixed at the start and target positions. Control values map
+// 64 -> 0 and 192 -> 1 so curves can overshoot either end by half a stroke.
+const uint32_t curveLookaheadMs = 20;
+
+float bezierControlValue(byte control) {
+  return (control - 64) * (1.0f / 128);
+}
+
+
+// Coefficients are computed once when the stroke starts
+void prepareCurve(StrokeCommand* stroke) {
+  stroke->startPosition = stepper->getCurrentPosition();
+  if (stroke->transType != TRANS_BEZIER)
+    return;
+  float p1 = bezierControlValue(stroke->easeType);
+  float p2 = bezierControlValue(stroke->auxiliary);
+  stroke->curveA = 1 + 3 * p1 - 3 * p2;
+  stroke->curveB = 3 * p2 - 6 * p1;
+  stroke->curveC = 3 * p1;
+}
+
+
+float curvePosition(StrokeCommand* stroke, uint32_t elapsedTimeMs) {
+  float t = min(MotionMath::toFloat(MotionMath::ratio(elapsedTimeMs, stroke->durationReciprocal)), 1.0f);
+  float curve = ((stroke->curveA * t + stroke->curveB) * t + stroke->curveC) * t;
+  return stroke->startPosition + (stroke->targetPosition - stroke->startPosition) * curve;
 }
 
 
@@ -336,11 +809,84 @@ void processSafeAccel() {
 }
 
 
+// Aim for where the curve will be one lookahead from now and get there in time
+void processCurveStroke(StrokeCommand* stroke, uint32_t elapsedTimeMs) {
+  int32_t target = lroundf(curvePosition(stroke, elapsedTimeMs + curveLookaheadMs));
+  uint32_t speedHz = abs(target - stepper->getCurrentPosition()) * 1000 / curveLookaheadMs;
+  speedHz = min(max(speedHz, (uint32_t)1), globalSpeedLimitHz);
+  if (overlayActive()) {
+    processOverlay(target, speedHz);
+  } else {
+    stepper->setSpeedInHz(speedHz);
+    stepper->moveTo(target);
+  }
+  processSafeAccel();
+}
+
+
 void processStroke(StrokeCommand* stroke, uint32_t elapsedTimeMs) {
-  double percentage = elapsedTimeMs * stroke->durationReciprocal;
-  double accelerationCurve = interpolate(percentage, stroke->transType, stroke->easeType);
-  uint32_t moveSpeedHz = round(stroke->baseSpeedHz * max(accelerationCurve, 0.01));
-  stepper->setSpeedInHz(min(moveSpeedHz, globalSpeedLimitHz));
-  stepper->moveTo(stroke->targetPosition);
+  if (stroke->transType == TRANS_BEZIER) {
+    processCurveStroke(stroke, elapsedTimeMs);
+    return;
+  }
+  MotionMath::Value percentage = MotionMath::ratio(elapsedTimeMs, stroke->durationReciprocal);
+  MotionMath::Value accelerationCurve = interpolate<MotionMath>(percentage, stroke->transType, stroke->easeType);
+  uint32_t moveSpeedHz = MotionMath::scaleHz(stroke->baseSpeedHz, accelerationCurve);
+  if (overlayActive()) {
+    processOverlay(stroke->targetPosition, min(moveSpeedHz, globalSpeedLimitHz));
+  } else {
+    stepper->setSpeedInHz(min(moveSpeedHz, globalSpeedLimitHz));
+    stepper->moveTo(stroke->targetPosition);
+  }
   processSafeAccel();
 }
+
+
+#ifdef MOTION_MATH_BENCHMARK
+template <typename M>
+void benchmarkMotionPolicy() {
+  const int weightSteps = 1000;
+  float maxError = 0;
+  for (int transType = TRANS_LINEAR; transType <= TRANS_QUINT; transType++) {
+    for (int easeType = EASE_IN; easeType <= EASE_OUT_IN; easeType++) {
+      for (int i = 0; i <= weightSteps; i++) {
+        typename M::Value weight = M::ratio(i, M::reciprocal(weightSteps));
+        double reference = interpolate<DoubleMath>((double)i / weightSteps, (TransType)transType, (EaseType)easeType);
+        double value = M::toFloat(interpolate<M>(weight, (TransType)transType, (EaseType)easeType));
+        maxError = max(maxError, (float)fabs(value - reference));
+      }
+    }
+  }
+
+  const uint32_t durationMs = 1500;
+  typename M::Ratio reciprocal = M::reciprocal(durationMs);
+  volatile uint32_t sink = 0;
+  unsigned long startUs = micros();
+  for (uint32_t elapsed = 0; elapsed < durationMs; elapsed++) {
+    for (int transType = TRANS_LINEAR; transType <= TRANS_QUINT; transType++) {
+      typename M::Value curve = interpolate<M>(M::ratio(elapsed, reciprocal), (TransType)transType, EASE_IN_OUT);
+      sink += M::scaleHz(20000, curve);
+    }
+  }
+  float tickUs = (micros() - startUs) / float(durationMs * (TRANS_QUINT + 1));
+
+  Serial.print("  ");
+  Serial.print(M::name());
+  Serial.print(": max error ");
+  Serial.print(maxError, 6);
+  Serial.print(", ");
+  Serial.print(tickUs, 3);
+  Serial.println(" us per tick");
+}
+
+
+void benchmarkMotionMath() {
+  Serial.println("");
+  Serial.println("Motion math policies:");
+  benchmarkMotionPolicy<DoubleMath>();
+  benchmarkMotionPolicy<FloatMath>();
+  benchmarkMotionPolicy<FixedMath>();
+  Serial.print("Active policy: ");
+  Serial.println(MotionMath::name());
+}
+#endif
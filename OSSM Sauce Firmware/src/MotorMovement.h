@@ -2,6 +2,8 @@
 #define MOTOR_MOVEMENT_H
 
 #include "FastAccelStepper.h"
+#include "MotionMath.h"
+#include "driver/gpio.h"
 
 #define motorDirectionPin 27
 #define motorEnablePin 26
@@ -10,6 +12,38 @@
 #define limitSwitchPin 12
 #define powerSensorPin 36
 
+// Runtime stall detection. While the motor is driven the power draw is
+// sampled every STALL_SAMPLE_INTERVAL_US, and a stall is the fast average
+// staying above the slow one by STALL_TRIGGER_MULTIPLIER times the boot
+// homing trigger range for STALL_TRIGGER_SAMPLES samples in a row. The
+// averages settle for STALL_SETTLE_MS after the motor starts from idle.
+// Build with -D STALL_TRIGGER_MULTIPLIER=0 to turn it off.
+#ifndef STALL_TRIGGER_MULTIPLIER
+#define STALL_TRIGGER_MULTIPLIER 4
+#endif
+#define STALL_SAMPLE_INTERVAL_US 5000
+#define STALL_TRIGGER_SAMPLES 8
+#define STALL_SETTLE_MS 1000
+
+// Auto-tune strokes across the user range, raising acceleration and then
+// speed by a step factor per level until the power draw shows the onset of
+// a stall, AUTOTUNE_ONSET of the stall trigger. The last clean level times
+// AUTOTUNE_MARGIN is kept as the tuned maximum. Each level runs
+// AUTOTUNE_LEVEL_STROKES strokes, the first only settles the averages.
+#define AUTOTUNE_ONSET 0.6
+#define AUTOTUNE_MARGIN 0.8
+#define AUTOTUNE_LEVEL_STROKES 3
+
+// Limit switch homing, the switch pulls limitSwitchPin low at the end the
+// rail reaches moving backward. The interrupt only wakes a task on the
+// first edge, which stops the motor and latches the step position, so
+// nothing in flash runs from the interrupt. The rail approaches fast, backs off and touches again
+// slowly. The far end is the configured rail length, or found sensorlessly
+// when that is 0.
+#define LIMIT_HOMING_FAST_HZ 4000
+#define LIMIT_HOMING_SLOW_HZ 400
+#define LIMIT_HOMING_BACKOFF_STEPS 400
+
 extern FastAccelStepper *stepper;
 
 extern float powerAvgRangeMultiplier;
@@ -23,6 +57,15 @@ extern int rangeLimitUserMax;
 extern uint32_t globalSpeedLimitHz;
 extern uint32_t globalAcceleration;
 
+// Limits found by auto-tune, 0 when untuned. Speed and acceleration
+// settings are clamped to them.
+extern uint32_t tunedSpeedLimitHz;
+extern uint32_t tunedAcceleration;
+
+extern bool homingBySwitch;
+extern uint32_t railLengthSteps;
+extern bool motorReversed;
+
 extern int homingTargetPosition;
 extern uint32_t homingSpeedHz;
 
@@ -38,7 +81,8 @@ enum TransType:byte {
   TRANS_QUAD,
   TRANS_CUBIC,
   TRANS_QUART,
-  TRANS_QUINT
+  TRANS_QUINT,
+  TRANS_BEZIER  // easeType and auxiliary carry the two control values
 };
 
 enum EaseType:byte {
@@ -56,8 +100,30 @@ extern enum MovementMode:byte {
   MODE_LOOP,
   MODE_VIBRATE,
   MODE_SMOOTH_MOVE,
+  MODE_CALIBRATE_VIBRATION,
+  MODE_PATTERN,
+  MODE_RECALIBRATE,
+  MODE_AUTOTUNE,
 } movementMode;
 
+// Runtime homing finds both end stops again without blocking the loop
+extern enum RecalibrateStage:byte {
+  RECALIBRATE_IDLE,
+  RECALIBRATE_SETTLE,
+  RECALIBRATE_SEEK_MAX,
+  RECALIBRATE_SEEK_MIN,
+  RECALIBRATE_DONE,
+  RECALIBRATE_FAILED,
+} recalibrateStage;
+
+extern enum AutoTuneStage:byte {
+  AUTOTUNE_IDLE,
+  AUTOTUNE_ACCELERATION,
+  AUTOTUNE_SPEED,
+  AUTOTUNE_DONE,
+  AUTOTUNE_FAILED,
+} autoTuneStage;
+
 struct StrokeCommand {
   uint32_t endTimeMs;
   short depth;
@@ -66,9 +132,13 @@ struct StrokeCommand {
   byte auxiliary;
   long targetPosition;
   uint32_t playTimeStartedMs;
-  float durationReciprocal;
+  MotionMath::Ratio durationReciprocal;
   uint32_t baseSpeedHz;
   bool active;
+  long startPosition;
+  float curveA;  // Bezier position y(t) = ((A * t + B) * t + C) * t
+  float curveB;
+  float curveC;
 };
 
 extern struct Vibration {
@@ -79,22 +149,51 @@ extern struct Vibration {
   uint8_t speedScaling;
   int32_t origin;
   int32_t crest;
-  Direction direction;
+  uint16_t deliveredRange;  // Range actually commanded, 0 - 10000 of user range
   float movementSpeed;
   bool timed;
   uint32_t endMs;
-  uint32_t currentMs;
   int32_t targetPosition;
 } vibration;
 
 void initializeMotor();
 
+// Pin interrupts bypass attachInterrupt, whose dispatcher is not in IRAM,
+// so they are still taken while a flash write has the cache disabled.
+// The handler and everything it calls must be in IRAM.
+void attachIramInterrupt(uint8_t pin, gpio_isr_t handler, gpio_int_type_t edge);
+
 void sensorlessHoming();
 
+void limitSwitchHoming();
+
+// Sets the hard and user limits inside the end stops found by homing
+void setHardLimits(int limitPhysicalMin, int limitPhysicalMax);
+
+// Returns true once when a stall is detected, call every loop
+bool monitorStall(bool motorDriven);
+
+void startRecalibration();
+
+// Returns true when the stage changed
+bool processRecalibration();
+
+// False when there is no power variance to judge the load against
+bool startAutoTune();
+
+// Returns true when the stage changed
+bool processAutoTune();
+
 uint32_t getMoveBaseSpeedHz(StrokeCommand stroke, uint32_t moveDuration, bool useFullUserRange = false);
 
+void prepareCurve(StrokeCommand* stroke);
+
 void processSafeAccel();
 
 void processStroke(StrokeCommand* stroke, uint32_t elapsedTimeMs);
 
+#ifdef MOTION_MATH_BENCHMARK
+void benchmarkMotionMath();
+#endif
+
 #endif
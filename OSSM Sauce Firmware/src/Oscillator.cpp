@@ -0,0 +1,326 @@
+#include "Oscillator.h"
+#include "MotorMovement.h"
+#include "Configuration.h"
+
+hw_timer_t* oscillatorTimer = NULL;
+TaskHandle_t oscillatorTaskHandle = NULL;
+
+volatile uint32_t oscillatorPhase = 0;
+volatile uint32_t oscillatorPhaseIncrement = 0;
+volatile bool oscillatorRunning = false;
+
+Waveform oscillatorWaveform = WAVE_SQUARE;
+uint32_t oscillatorPeriod = 1000000;
+
+uint8_t waveformTable[OSCILLATOR_TABLE_SIZE];
+uint8_t waveformTableLength = 0;
+float waveformTableSlope = 0;
+
+// Peak to peak range the stepper actually reached at each frequency, only
+// valid for the acceleration and speed limit it was measured with
+const float calibrationFrequenciesHz[CALIBRATION_POINTS] = {1, 2, 3, 5, 8, 12, 18, 27, 40, 60, 90, 135};
+
+struct VibrationResponse {
+  uint32_t acceleration;
+  uint32_t speedLimitHz;
+  uint32_t rangeSteps[CALIBRATION_POINTS];
+} vibrationResponse;
+
+bool vibrationResponseValid = false;
+bool vibrationResponseChanged = false;
+
+// Vibration layered on MOVE, LOOP and SMOOTH_MOVE strokes. The stroke is
+// tracked as a virtual base position and the waveform is added on top of it
+// every control tick, so no POSITION streaming is needed.
+struct {
+  bool enabled;
+  bool timed;
+  uint32_t endMs;
+  Waveform waveform;
+  uint32_t phase;
+  float phaseIncrementPerUs;
+  float rangePercent;
+  float basePosition;
+  unsigned long lastTickUs;
+} overlay;
+
+struct {
+  uint8_t point;
+  unsigned long stageStartMs;
+  int32_t minPosition;
+  int32_t maxPosition;
+  VibrationResponse response;
+} calibration;
+
+
+void IRAM_ATTR onOscillatorTimer() {
+  oscillatorPhase += oscillatorPhaseIncrement;
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(oscillatorTaskHandle, &higherPriorityTaskWoken);
+  if (higherPriorityTaskWoken)
+    portYIELD_FROM_ISR();
+}
+
+
+// Position between origin (0) and crest (1) at the given phase
+float waveformSample(Waveform waveform, uint32_t phase) {
+  float cycle = phase * (1.0f / 4294967296.0f);
+  switch (waveform) {
+    case WAVE_SINE:
+      return 0.5f - 0.5f * cosf(cycle * (float)TWO_PI);
+    case WAVE_TRIANGLE:
+      return 1 - fabsf(2 * cycle - 1);
+    case WAVE_TABLE: {
+      if (waveformTableLength < 2)
+        return 0;
+      float index = cycle * waveformTableLength;
+      uint8_t sampleIndex = index;
+      uint8_t nextIndex = (sampleIndex + 1) % waveformTableLength;
+      float blend = index - sampleIndex;
+      float sample = waveformTable[sampleIndex] + (waveformTable[nextIndex] - waveformTable[sampleIndex]) * blend;
+      return sample * (1.0f / 255);
+    }
+    default:
+      return (phase < 0x80000000) ? 1 : 0;
+  }
+}
+
+
+// Runs on every timer tick while vibrating, stops the timer otherwise
+void oscillatorTask(void *parameter) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (movementMode != MODE_VIBRATE && movementMode != MODE_CALIBRATE_VIBRATION) {
+      timerAlarmDisable(oscillatorTimer);
+      oscillatorRunning = false;
+      continue;
+    }
+    int32_t target = vibration.origin + lroundf((vibration.crest - vibration.origin) * oscillatorSample());
+    if (target != stepper->targetPos())
+      stepper->moveTo(target);
+  }
+}
+
+
+void initializeOscillator() {
+  if (preferences.getBytes("vib_response", &vibrationResponse, sizeof(vibrationResponse)) == sizeof(vibrationResponse))
+    vibrationResponseValid = true;
+  xTaskCreatePinnedToCore(oscillatorTask, "oscillator", 4096, NULL, 5, &oscillatorTaskHandle, 1);
+  oscillatorTimer = timerBegin(OSCILLATOR_TIMER, 80, true);  // 1 MHz
+  timerAttachInterrupt(oscillatorTimer, &onOscillatorTimer, true);
+  timerAlarmWrite(oscillatorTimer, 1000000 / OSCILLATOR_TICK_HZ, true);
+}
+
+
+// Phase continuous, the new frequency applies from the current phase on
+void oscillatorConfigure(Waveform waveform, uint32_t periodUs) {
+  oscillatorPeriod = max(periodUs, (uint32_t)OSCILLATOR_MIN_PERIOD_US);
+  oscillatorWaveform = (waveform <= WAVE_TABLE) ? waveform : WAVE_SQUARE;
+  const uint64_t tickUs = 1000000 / OSCILLATOR_TICK_HZ;
+  oscillatorPhaseIncrement = (tickUs << 32) / oscillatorPeriod;
+}
+
+
+void oscillatorStart() {
+  if (oscillatorRunning)
+    return;
+  oscillatorPhase = 0;
+  oscillatorRunning = true;
+  timerAlarmEnable(oscillatorTimer);
+}
+
+
+bool oscillatorSetTable(const uint8_t* samples, uint8_t length) {
+  if (length < 2 || length > OSCILLATOR_TABLE_SIZE)
+    return false;
+  int maxStep = 0;
+  for (int i = 0; i < length; i++) {
+    waveformTable[i] = samples[i];
+    maxStep = max(maxStep, abs(samples[(i + 1) % length] - samples[i]));
+  }
+  waveformTableSlope = maxStep * length / 255.0f;
+  waveformTableLength = length;
+  return true;
+}
+
+
+uint32_t oscillatorPeriodUs() {
+  return oscillatorPeriod;
+}
+
+
+// Peak rate of change in ranges per cycle, used to size the stepper speed.
+// Square is driven like the triangle, edges are limited by acceleration.
+float waveformPeakSlope(Waveform waveform) {
+  switch (waveform) {
+    case WAVE_SINE:
+      return PI;
+    case WAVE_TABLE:
+      return waveformTableSlope;
+    default:
+      return 2;
+  }
+}
+
+
+float oscillatorPeakSlope() {
+  return waveformPeakSlope(oscillatorWaveform);
+}
+
+
+float oscillatorSample() {
+  return waveformSample(oscillatorWaveform, oscillatorPhase);
+}
+
+
+void setCalibrationFrequency(uint8_t point) {
+  float frequencyHz = calibrationFrequenciesHz[point];
+  oscillatorConfigure(WAVE_SQUARE, 1000000 / frequencyHz);
+  uint32_t range = vibration.crest - vibration.origin;
+  uint32_t speed = range * oscillatorPeakSlope() * frequencyHz;
+  stepper->setSpeedInHz(min(speed, globalSpeedLimitHz));
+  calibration.point = point;
+  calibration.stageStartMs = millis();
+  calibration.minPosition = INT32_MAX;
+  calibration.maxPosition = INT32_MIN;
+}
+
+
+// Square wave over the full user range, as sent by the app's vibration controls
+void startVibrationCalibration() {
+  vibration.origin = min(rangeLimitUserMin, rangeLimitUserMax);
+  vibration.crest = max(rangeLimitUserMin, rangeLimitUserMax);
+  vibration.timed = false;
+  calibration.response.acceleration = globalAcceleration;
+  calibration.response.speedLimitHz = globalSpeedLimitHz;
+  setCalibrationFrequency(0);
+  processSafeAccel();
+  movementMode = MODE_CALIBRATE_VIBRATION;
+  oscillatorStart();
+}
+
+
+// Let each frequency settle, then record the peak to peak range reached.
+// Returns true once the last frequency has been measured.
+bool processVibrationCalibration() {
+  uint32_t periodMs = oscillatorPeriodUs() / 1000;
+  uint32_t settleMs = max(2 * periodMs, (uint32_t)200);
+  uint32_t measureMs = max(3 * periodMs, (uint32_t)300);
+  uint32_t elapsedMs = millis() - calibration.stageStartMs;
+  if (elapsedMs < settleMs)
+    return false;
+
+  int32_t currentPosition = stepper->getCurrentPosition();
+  calibration.minPosition = min(calibration.minPosition, currentPosition);
+  calibration.maxPosition = max(calibration.maxPosition, currentPosition);
+  if (elapsedMs < settleMs + measureMs)
+    return false;
+
+  calibration.response.rangeSteps[calibration.point] = calibration.maxPosition - calibration.minPosition;
+  if (calibration.point < CALIBRATION_POINTS - 1) {
+    setCalibrationFrequency(calibration.point + 1);
+    return false;
+  }
+
+  // Back to rest at homing speed, the oscillator stops on its next tick
+  movementMode = MODE_IDLE;
+  stepper->setAcceleration(globalAcceleration);
+  stepper->setSpeedInHz(min(homingSpeedHz, globalSpeedLimitHz));
+  stepper->moveTo(rangeLimitUserMin);
+  vibrationResponse = calibration.response;
+  vibrationResponseValid = true;
+  vibrationResponseChanged = true;
+  markSettingsChanged();
+  return true;
+}
+
+
+// Largest range the stepper can follow at this frequency with the current
+// limits, or UINT32_MAX if there is no matching calibration
+uint32_t getAchievableVibrationRange(float frequencyHz) {
+  if (!vibrationResponseValid ||
+      vibrationResponse.acceleration != globalAcceleration ||
+      vibrationResponse.speedLimitHz != globalSpeedLimitHz)
+    return UINT32_MAX;
+
+  const uint32_t* rangeSteps = vibrationResponse.rangeSteps;
+  if (frequencyHz <= calibrationFrequenciesHz[0])
+    return rangeSteps[0];
+  for (int i = 1; i < CALIBRATION_POINTS; i++) {
+    if (frequencyHz <= calibrationFrequenciesHz[i]) {
+      float lowHz = calibrationFrequenciesHz[i - 1];
+      float blend = (frequencyHz - lowHz) / (calibrationFrequenciesHz[i] - lowHz);
+      return rangeSteps[i - 1] + ((float)rangeSteps[i] - rangeSteps[i - 1]) * blend;
+    }
+  }
+  // Acceleration limited range falls with the square of frequency
+  float ratio = calibrationFrequenciesHz[CALIBRATION_POINTS - 1] / frequencyHz;
+  return rangeSteps[CALIBRATION_POINTS - 1] * ratio * ratio;
+}
+
+
+void saveVibrationResponse() {
+  vibrationResponseChanged = false;
+  preferences.putBytes("vib_response", &vibrationResponse, sizeof(vibrationResponse));
+}
+
+
+void configureOverlay(Waveform waveform, uint32_t periodUs, uint8_t rangePercent, int32_t durationMs) {
+  if (durationMs == 0) {
+    overlay.enabled = false;
+    return;
+  }
+  periodUs = max(periodUs, (uint32_t)OSCILLATOR_MIN_PERIOD_US);
+  overlay.waveform = (waveform <= WAVE_TABLE) ? waveform : WAVE_SQUARE;
+  overlay.phaseIncrementPerUs = 4294967296.0f / periodUs;
+  overlay.rangePercent = min(rangePercent, (uint8_t)100);
+  overlay.timed = durationMs > 0;
+  overlay.endMs = millis() + durationMs;
+  if (!overlay.enabled) {
+    overlay.phase = 0;
+    overlay.lastTickUs = 0;
+  }
+  overlay.enabled = true;
+}
+
+
+bool overlayActive() {
+  if (overlay.enabled && overlay.timed && (int32_t)(millis() - overlay.endMs) >= 0)
+    overlay.enabled = false;
+  return overlay.enabled;
+}
+
+
+// Called from processStroke() in place of moving straight to the target
+void processOverlay(int32_t baseTarget, uint32_t baseSpeedHz) {
+  unsigned long nowUs = micros();
+  unsigned long elapsedUs = nowUs - overlay.lastTickUs;
+  overlay.lastTickUs = nowUs;
+
+  // Pick the base up from the stepper after a gap (pause, homing, new mode)
+  if (elapsedUs > 50000) {
+    overlay.basePosition = stepper->getCurrentPosition();
+    elapsedUs = 0;
+  }
+
+  float baseStep = baseSpeedHz * elapsedUs * 0.000001f;
+  float remaining = baseTarget - overlay.basePosition;
+  if (fabsf(remaining) <= baseStep)
+    overlay.basePosition = baseTarget;
+  else
+    overlay.basePosition += (remaining > 0) ? baseStep : -baseStep;
+
+  overlay.phase += (uint32_t)(overlay.phaseIncrementPerUs * elapsedUs);
+  float totalRange = abs(rangeLimitUserMax - rangeLimitUserMin);
+  float amplitude = overlay.rangePercent * 0.01f * totalRange;
+  float offset = amplitude * waveformSample(overlay.waveform, overlay.phase);
+
+  int32_t lowLimit = min(rangeLimitUserMin, rangeLimitUserMax);
+  int32_t highLimit = max(rangeLimitUserMin, rangeLimitUserMax);
+  int32_t target = constrain(lroundf(overlay.basePosition + offset), lowLimit, highLimit);
+
+  float frequencyHz = overlay.phaseIncrementPerUs * 1000000.0f / 4294967296.0f;
+  uint32_t overlaySpeedHz = amplitude * waveformPeakSlope(overlay.waveform) * frequencyHz;
+  stepper->setSpeedInHz(min(baseSpeedHz + overlaySpeedHz, globalSpeedLimitHz));
+  stepper->moveTo(target);
+}
@@ -0,0 +1,57 @@
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <Arduino.h>
+
+// Vibration waveforms are generated by a phase accumulator advanced from a
+// hardware timer, so the period is independent of loop() timing
+#define OSCILLATOR_TIMER 0
+#define OSCILLATOR_TICK_HZ 2000
+#define OSCILLATOR_MIN_PERIOD_US (2 * 1000000 / OSCILLATOR_TICK_HZ)
+#define OSCILLATOR_TABLE_SIZE 64
+
+// Frequencies the amplitude response is measured at
+#define CALIBRATION_POINTS 12
+
+enum Waveform:byte {
+  WAVE_SQUARE,
+  WAVE_SINE,
+  WAVE_TRIANGLE,
+  WAVE_TABLE
+};
+
+void initializeOscillator();
+
+void oscillatorConfigure(Waveform waveform, uint32_t periodUs);
+
+void oscillatorStart();
+
+bool oscillatorSetTable(const uint8_t* samples, uint8_t length);
+
+uint32_t oscillatorPeriodUs();
+
+float oscillatorPeakSlope();
+
+float oscillatorSample();
+
+float waveformSample(Waveform waveform, uint32_t phase);
+
+float waveformPeakSlope(Waveform waveform);
+
+void configureOverlay(Waveform waveform, uint32_t periodUs, uint8_t rangePercent, int32_t durationMs);
+
+bool overlayActive();
+
+void processOverlay(int32_t baseTarget, uint32_t baseSpeedHz);
+
+void startVibrationCalibration();
+
+bool processVibrationCalibration();
+
+uint32_t getAchievableVibrationRange(float frequencyHz);
+
+extern bool vibrationResponseChanged;
+
+void saveVibrationResponse();
+
+#endif
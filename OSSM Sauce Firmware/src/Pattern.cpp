@@ -0,0 +1,240 @@
+#include "Pattern.h"
+#include "MotorMovement.h"
+
+uint8_t patternProgram[PATTERN_MAX_SIZE];
+size_t patternLength = 0;
+
+struct PatternRepeat {
+  uint16_t startPc;
+  uint8_t remaining;  // 0 = forever
+};
+
+struct {
+  uint16_t pc;
+  PatternRepeat repeats[PATTERN_MAX_NESTING];
+  uint8_t repeatDepth;
+
+  StrokeCommand segment;
+  uint16_t segmentDepth;
+  float progress;
+  uint32_t unitSpeedHz;  // Base speed at 100% tempo
+  bool segmentActive;
+  unsigned long lastTickMs;
+
+  float programTempo;
+  float tempoStart;
+  float tempoTarget;
+  uint16_t tempoRampMs;
+  uint32_t tempoRampElapsedMs;
+
+  uint16_t depthJitter;
+  uint8_t timeJitterPercent;
+
+  float userTempo;
+  uint16_t depthScale;
+} pattern = {};
+
+
+uint8_t patternOpcodeSize(uint8_t opcode) {
+  switch (opcode) {
+    case PATTERN_END:     return 1;
+    case PATTERN_SEGMENT: return 7;
+    case PATTERN_REPEAT:  return 2;
+    case PATTERN_NEXT:    return 1;
+    case PATTERN_TEMPO:   return 5;
+    case PATTERN_RANDOM:  return 4;
+    default:              return 0;
+  }
+}
+
+
+bool validatePattern(const uint8_t* program, size_t length) {
+  int nesting = 0;
+  bool hasSegment = false;
+  size_t pc = 0;
+  while (pc < length) {
+    uint8_t size = patternOpcodeSize(program[pc]);
+    if (size == 0 || pc + size > length)
+      return false;
+    switch (program[pc]) {
+      case PATTERN_SEGMENT:
+        hasSegment = true;
+        break;
+      case PATTERN_REPEAT:
+        if (++nesting > PATTERN_MAX_NESTING)
+          return false;
+        break;
+      case PATTERN_NEXT:
+        if (--nesting < 0)
+          return false;
+        break;
+    }
+    pc += size;
+  }
+  return hasSegment && nesting == 0;
+}
+
+
+uint16_t readU16(uint16_t pc) {
+  return patternProgram[pc] | (patternProgram[pc + 1] << 8);
+}
+
+
+long patternTargetPosition(uint16_t depth) {
+  long scaledDepth = (long)depth * pattern.depthScale / 10000;
+  return map(scaledDepth, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
+}
+
+
+float patternTempo() {
+  return pattern.programTempo * pattern.userTempo * 0.01f;
+}
+
+
+void startSegment(uint16_t pc) {
+  uint16_t durationMs = readU16(pc + 1);
+  long depth = readU16(pc + 3);
+  if (pattern.depthJitter)
+    depth += random(-pattern.depthJitter, pattern.depthJitter + 1);
+  if (pattern.timeJitterPercent) {
+    long jitterMs = (long)durationMs * pattern.timeJitterPercent / 100;
+    durationMs = constrain(durationMs + random(-jitterMs, jitterMs + 1), 1, 65535);
+  }
+  durationMs = max(durationMs, (uint16_t)1);
+
+  pattern.segmentDepth = constrain(depth, 0, 10000);
+  pattern.segment.endTimeMs = durationMs;
+  pattern.segment.transType = static_cast<TransType>(patternProgram[pc + 5]);
+  pattern.segment.easeType = static_cast<EaseType>(patternProgram[pc + 6]);
+  pattern.segment.targetPosition = patternTargetPosition(pattern.segmentDepth);
+  pattern.segment.durationReciprocal = MotionMath::reciprocal(durationMs);
+  pattern.unitSpeedHz = getMoveBaseSpeedHz(pattern.segment, durationMs);
+  prepareCurve(&pattern.segment);
+  pattern.segmentActive = true;
+}
+
+
+// Run instructions until the next segment starts
+bool fetchSegment() {
+  for (int executed = 0; executed < 64; executed++) {
+    uint16_t pc = pattern.pc;
+    if (pc >= patternLength) {
+      pattern.pc = 0;
+      continue;
+    }
+    pattern.pc += patternOpcodeSize(patternProgram[pc]);
+    switch (patternProgram[pc]) {
+      case PATTERN_END:
+        pattern.pc = 0;
+        pattern.repeatDepth = 0;
+        break;
+
+      case PATTERN_SEGMENT:
+        startSegment(pc);
+        return true;
+
+      case PATTERN_REPEAT: {
+        PatternRepeat& repeat = pattern.repeats[pattern.repeatDepth++];
+        repeat.startPc = pattern.pc;
+        repeat.remaining = patternProgram[pc + 1];
+        break;
+      }
+
+      case PATTERN_NEXT: {
+        PatternRepeat& repeat = pattern.repeats[pattern.repeatDepth - 1];
+        if (repeat.remaining == 0 || --repeat.remaining > 0)
+          pattern.pc = repeat.startPc;
+        else
+          pattern.repeatDepth--;
+        break;
+      }
+
+      case PATTERN_TEMPO:
+        pattern.tempoStart = pattern.programTempo;
+        pattern.tempoTarget = readU16(pc + 1);
+        pattern.tempoRampMs = readU16(pc + 3);
+        pattern.tempoRampElapsedMs = 0;
+        if (pattern.tempoRampMs == 0)
+          pattern.programTempo = pattern.tempoTarget;
+        break;
+
+      case PATTERN_RANDOM:
+        pattern.depthJitter = readU16(pc + 1);
+        pattern.timeJitterPercent = patternProgram[pc + 3];
+        break;
+    }
+  }
+  // No segment reached, a block without segments repeats forever
+  pattern.segmentActive = false;
+  return false;
+}
+
+
+bool loadPattern(const uint8_t* program, size_t length) {
+  if (length > PATTERN_MAX_SIZE || !validatePattern(program, length))
+    return false;
+  memcpy(patternProgram, program, length);
+  patternLength = length;
+  pattern.pc = 0;
+  pattern.repeatDepth = 0;
+  pattern.segmentActive = false;
+  pattern.progress = 0;
+  pattern.programTempo = 100;
+  pattern.tempoRampMs = 0;
+  pattern.depthJitter = 0;
+  pattern.timeJitterPercent = 0;
+  if (pattern.userTempo == 0) {
+    pattern.userTempo = 100;
+    pattern.depthScale = 10000;
+  }
+  return true;
+}
+
+
+bool patternLoaded() {
+  return patternLength > 0;
+}
+
+
+void setPatternControl(uint16_t tempoPercent, uint16_t depthScale) {
+  pattern.userTempo = constrain(tempoPercent, 10, 1000);
+  pattern.depthScale = constrain(depthScale, 0, 10000);
+  if (!pattern.segmentActive)
+    return;
+  // Retarget the running segment, speed covers what is left of it
+  pattern.segment.targetPosition = patternTargetPosition(pattern.segmentDepth);
+  uint32_t remainingMs = max((1 - pattern.progress) * pattern.segment.endTimeMs, 1.0f);
+  pattern.unitSpeedHz = getMoveBaseSpeedHz(pattern.segment, remainingMs);
+}
+
+
+// Segment progress advances by elapsed time scaled with tempo, so tempo and
+// depth changes never restart the phase
+void processPattern() {
+  unsigned long now = millis();
+  uint32_t elapsedMs = now - pattern.lastTickMs;
+  pattern.lastTickMs = now;
+  if (elapsedMs > 50)  // Resuming from pause
+    elapsedMs = 0;
+
+  if (!pattern.segmentActive && !fetchSegment())
+    return;
+
+  if (pattern.tempoRampElapsedMs < pattern.tempoRampMs) {
+    pattern.tempoRampElapsedMs = min(pattern.tempoRampElapsedMs + elapsedMs, (uint32_t)pattern.tempoRampMs);
+    float ramp = (float)pattern.tempoRampElapsedMs / pattern.tempoRampMs;
+    pattern.programTempo = pattern.tempoStart + (pattern.tempoTarget - pattern.tempoStart) * ramp;
+  }
+
+  float tempo = patternTempo();
+  pattern.progress += elapsedMs * tempo * 0.01f / pattern.segment.endTimeMs;
+  if (pattern.progress >= 1) {
+    float carryMs = (pattern.progress - 1) * pattern.segment.endTimeMs;
+    if (!fetchSegment())
+      return;
+    pattern.progress = min(carryMs / pattern.segment.endTimeMs, 1.0f);
+  }
+
+  pattern.segment.baseSpeedHz = pattern.unitSpeedHz * tempo * 0.01f;
+  processStroke(&pattern.segment, pattern.progress * pattern.segment.endTimeMs);
+}
@@ -0,0 +1,39 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <Arduino.h>
+
+// Pattern programs are uploaded once with PATTERN_UPLOAD and run on the
+// device in MODE_PATTERN. Little-endian bytecode, one opcode byte followed
+// by its arguments:
+//
+//   PATTERN_END                                  restart from the beginning
+//   PATTERN_SEGMENT  u16 durationMs, u16 depth (0 - 10000), u8 trans, u8 ease
+//   PATTERN_REPEAT   u8 count (0 = forever)      start of repeated block
+//   PATTERN_NEXT                                 end of repeated block
+//   PATTERN_TEMPO    u16 tempoPercent, u16 rampMs
+//   PATTERN_RANDOM   u16 depthJitter (0 - 10000), u8 timeJitterPercent
+//
+// Tempo and depth can be changed live with PATTERN_CONTROL, both apply to
+// the running segment without restarting the pattern.
+#define PATTERN_MAX_SIZE 512
+#define PATTERN_MAX_NESTING 4
+
+enum PatternOpcode:byte {
+  PATTERN_END,
+  PATTERN_SEGMENT,
+  PATTERN_REPEAT,
+  PATTERN_NEXT,
+  PATTERN_TEMPO,
+  PATTERN_RANDOM
+};
+
+bool loadPattern(const uint8_t* program, size_t length);
+
+bool patternLoaded();
+
+void setPatternControl(uint16_t tempoPercent, uint16_t depthScale);
+
+void processPattern();
+
+#endif
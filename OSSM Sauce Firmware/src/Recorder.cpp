@@ -0,0 +1,70 @@
+#include "Recorder.h"
+#include "Configuration.h"
+#include "MotorMovement.h"
+
+RecordedCommand recording[RECORDER_SIZE];
+uint16_t recordingNext = 0;
+uint16_t recordingCount = 0;
+volatile bool recorderDumping = false;
+
+// handleCommand records from the websocket, controller server and loop tasks
+portMUX_TYPE recorderMux = portMUX_INITIALIZER_UNLOCKED;
+
+const TickType_t recordingSendTimeout = pdMS_TO_TICKS(200);
+
+
+// Called for every message before it is decoded. The entry is built first
+// and only claiming its slot and copying it in hold the lock.
+void recordCommand(const uint8_t* message, size_t length, uint32_t playTimeMs, uint8_t queuedMoves) {
+  if (recorderDumping)
+    return;
+  RecordedCommand entry;
+  entry.arrivalUs = micros();
+  entry.playTimeMs = playTimeMs;
+  entry.position = stepper->getCurrentPosition();
+  entry.length = min(length, (size_t)UINT16_MAX);
+  entry.movementMode = movementMode;
+  entry.queuedMoves = queuedMoves;
+  memset(entry.data, 0, RECORDER_DATA_SIZE);
+  memcpy(entry.data, message, min(length, (size_t)RECORDER_DATA_SIZE));
+
+  portENTER_CRITICAL(&recorderMux);
+  if (!recorderDumping) {
+    recording[recordingNext] = entry;
+    recordingNext = (recordingNext + 1) % RECORDER_SIZE;
+    if (recordingCount < RECORDER_SIZE)
+      recordingCount++;
+  }
+  portEXIT_CRITICAL(&recorderMux);
+}
+
+
+// Runs on the response task so a dump never stalls the motion loop
+void sendRecording(uint8_t frameType) {
+  portENTER_CRITICAL(&recorderMux);
+  recorderDumping = true;
+  uint16_t total = recordingCount;
+  uint16_t oldest = (recordingNext + RECORDER_SIZE - total) % RECORDER_SIZE;
+  portEXIT_CRITICAL(&recorderMux);
+  const size_t headerSize = 5;
+  static uint8_t frame[headerSize + RECORDER_FRAME_ENTRIES * sizeof(RecordedCommand)];
+  frame[0] = frameType;
+  memcpy(frame + 3, &total, 2);
+
+  uint16_t index = 0;
+  do {
+    uint16_t count = min((uint16_t)(total - index), (uint16_t)RECORDER_FRAME_ENTRIES);
+    memcpy(frame + 1, &index, 2);
+    for (uint16_t i = 0; i < count; i++) {
+      const RecordedCommand* entry = &recording[(oldest + index + i) % RECORDER_SIZE];
+      memcpy(frame + headerSize + i * sizeof(RecordedCommand), entry, sizeof(RecordedCommand));
+    }
+    size_t frameSize = headerSize + count * sizeof(RecordedCommand);
+    if (esp_websocket_client_send_bin(wsClient, (const char*)frame, frameSize, recordingSendTimeout) < 0) {
+      Serial.println("ERROR: Recording send timed out.");
+      break;
+    }
+    index += count;
+  } while (index < total);
+  recorderDumping = false;
+}
@@ -0,0 +1,32 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <Arduino.h>
+
+// Flight recorder, keeps the last RECORDER_SIZE decoded commands with their
+// arrival time and the motion state at that instant. RECORDER_DUMP sends it
+// to the app oldest first as binary frames:
+//
+//   [RECORDER_DUMP][u16 first index][u16 total entries][RecordedCommand ...]
+//
+// Commands longer than RECORDER_DATA_SIZE keep only their first bytes,
+// length holds the full size. Recording pauses while a dump is sent.
+#define RECORDER_SIZE 256
+#define RECORDER_DATA_SIZE 24
+#define RECORDER_FRAME_ENTRIES 32
+
+struct __attribute__((packed)) RecordedCommand {
+  uint32_t arrivalUs;
+  uint32_t playTimeMs;
+  int32_t position;
+  uint16_t length;
+  uint8_t movementMode;
+  uint8_t queuedMoves;
+  uint8_t data[RECORDER_DATA_SIZE];
+};
+
+void recordCommand(const uint8_t* message, size_t length, uint32_t playTimeMs, uint8_t queuedMoves);
+
+void sendRecording(uint8_t frameType);
+
+#endif
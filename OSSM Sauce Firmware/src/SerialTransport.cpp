@@ -0,0 +1,130 @@
+#include "SerialTransport.h"
+#include "ControllerServer.h"
+#include "TCode.h"
+#include "Configuration.h"
+
+volatile SerialMode serialMode = SERIAL_TEXT;
+
+uint8_t serialFrame[SERIAL_FRAME_SIZE];
+size_t serialFrameLength = 0;
+bool serialFrameOverflow = false;
+
+
+uint16_t crc16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+
+// Decodes in place, returns the decoded length or 0 for a malformed frame
+size_t cobsDecode(uint8_t* data, size_t length) {
+  size_t read = 0;
+  size_t write = 0;
+  while (read < length) {
+    uint8_t code = data[read++];
+    if (code == 0 || read + code - 1 > length)
+      return 0;
+    for (uint8_t i = 1; i < code; i++)
+      data[write++] = data[read++];
+    if (code < 0xFF && read < length)
+      data[write++] = 0;
+  }
+  return write;
+}
+
+
+void setSerialMode(SerialMode mode, uint32_t baud) {
+  Serial.flush();
+  if (baud > 0)
+    Serial.updateBaudRate(baud);
+  serialMode = mode;
+  serialFrameLength = 0;
+  serialFrameOverflow = false;
+}
+
+
+SerialMode getSerialMode() {
+  return serialMode;
+}
+
+
+void handleSerialFrame() {
+  size_t length = cobsDecode(serialFrame, serialFrameLength);
+  if (length < 3)
+    return;
+  uint16_t crc;
+  memcpy(&crc, serialFrame + length - 2, 2);
+  if (crc != crc16(serialFrame, length - 2)) {
+    Serial.println("ERROR: Serial frame CRC mismatch.");
+    return;
+  }
+  handleCommand(serialFrame, length - 2, SOURCE_SERIAL);
+}
+
+
+// Called from loop(), never blocks
+void pollSerial() {
+  drainConsoleOutput();
+  if (serialMode == SERIAL_TEXT) {
+    if (configConsoleActive())
+      pollConfigConsole();
+    else
+      pollTCodeSerial();
+    return;
+  }
+  while (Serial.available()) {
+    uint8_t received = Serial.read();
+    if (received != 0) {
+      if (serialFrameLength < SERIAL_FRAME_SIZE)
+        serialFrame[serialFrameLength++] = received;
+      else
+        serialFrameOverflow = true;
+      continue;
+    }
+    if (serialFrameOverflow)
+      Serial.println("ERROR: Serial frame too large.");
+    else if (serialFrameLength > 0)
+      handleSerialFrame();
+    serialFrameLength = 0;
+    serialFrameOverflow = false;
+    if (serialMode != SERIAL_BINARY)
+      return;
+  }
+}
+
+
+// Responses from the response task, only sent in binary mode
+void serialSend(const uint8_t* message, size_t length) {
+  if (serialMode != SERIAL_BINARY || length > 32)
+    return;
+  uint8_t packet[34];
+  memcpy(packet, message, length);
+  uint16_t crc = crc16(message, length);
+  memcpy(packet + length, &crc, 2);
+  length += 2;
+
+  // Leading delimiter ends any log text printed since the last frame
+  uint8_t encoded[34 + 3];
+  encoded[0] = 0;
+  size_t codeIndex = 1;
+  size_t write = 2;
+  uint8_t code = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (packet[i] == 0) {
+      encoded[codeIndex] = code;
+      codeIndex = write++;
+      code = 1;
+    } else {
+      encoded[write++] = packet[i];
+      code++;
+    }
+  }
+  encoded[codeIndex] = code;
+  encoded[write++] = 0;
+  Serial.write(encoded, write);
+}
@@ -0,0 +1,37 @@
+#ifndef SERIAL_TRANSPORT_H
+#define SERIAL_TRANSPORT_H
+
+#include <Arduino.h>
+
+// The serial port reads T-Code text by default. In binary mode it carries
+// the same command packets as the websocket, each framed as
+//
+//   COBS([command packet][u16 CRC-16/CCITT of the packet]) 0x00
+//
+// and responses come back in the same framing, with a leading 0x00 as
+// well. Log lines are still printed in binary mode, the leading delimiter
+// closes any such text as a frame of its own, which fails the CRC and is
+// dropped by the host without taking the response after it along. Each
+// frame goes out in a single write so text from other tasks cannot land
+// inside it. SERIAL_MODE
+// [u8 mode][u32 baud, 0 keeps the current] switches at runtime from any
+// source, the T-Code line DBINARY switches a text session to binary.
+#define SERIAL_DEFAULT_BAUD 115200
+#define SERIAL_FRAME_SIZE 640
+
+enum SerialMode:uint8_t {
+  SERIAL_TEXT,
+  SERIAL_BINARY
+};
+
+void setSerialMode(SerialMode mode, uint32_t baud);
+
+SerialMode getSerialMode();
+
+void pollSerial();
+
+void serialSend(const uint8_t* message, size_t length);
+
+uint16_t crc16(const uint8_t* data, size_t length);
+
+#endif
@@ -0,0 +1,195 @@
+#include "TCode.h"
+#include "MotorMovement.h"
+#include "Oscillator.h"
+#include "ControllerServer.h"
+#include "SerialTransport.h"
+#include "Configuration.h"
+
+const TCodeOptions defaultTCodeOptions = {TRANS_SINE, false, 20, UINT16_MAX, SOURCE_SERIAL};
+
+char tcodeSerialLine[TCODE_LINE_SIZE];
+size_t tcodeSerialLength = 0;
+
+// Commands collected from the current line, applied at its end. Each
+// processTCode call parses into its own, only applying a line takes the
+// lock, since the websocket, controller server and loop tasks all send
+// T-Code.
+struct TCodeLine {
+  bool hasStroke;
+  uint16_t strokeDepth;
+  uint32_t strokeIntervalMs;
+  uint32_t strokeSpeed;
+  bool hasVibration;
+  uint16_t vibrationLevel;
+  uint32_t vibrationIntervalMs;
+  bool stop;
+};
+
+SemaphoreHandle_t tcodeMutex;
+uint16_t tcodeLastDepth = 5000;
+
+
+void initializeTCode() {
+  tcodeMutex = xSemaphoreCreateMutex();
+}
+
+
+// Fraction digits to 0 - 10000, extra digits past the fourth only round
+uint16_t parseTCodeValue(const char*& cursor, const char* end) {
+  uint32_t value = 0;
+  uint32_t scale = 1;
+  while (cursor < end && isdigit(*cursor)) {
+    if (scale < 100000) {
+      value = value * 10 + (*cursor - '0');
+      scale *= 10;
+    }
+    cursor++;
+  }
+  return (scale == 1) ? 0 : (value * 10000 + scale / 2) / scale;
+}
+
+
+uint32_t parseTCodeNumber(const char*& cursor, const char* end) {
+  uint32_t value = 0;
+  while (cursor < end && isdigit(*cursor)) {
+    value = min(value * 10 + (*cursor - '0'), (uint32_t)3600000);
+    cursor++;
+  }
+  return value;
+}
+
+
+void replyTCode(const char* reply) {
+  Serial.println(reply);
+}
+
+
+void parseTCodeCommand(const char* cursor, const char* end, TCodeLine& line) {
+  char type = toupper(*cursor++);
+  if (type == 'D') {
+    if (end - cursor == 6 && strncasecmp(cursor, "BINARY", 6) == 0) {
+      setSerialMode(SERIAL_BINARY, 0);
+    } else if (end - cursor == 4 && strncasecmp(cursor, "STOP", 4) == 0) {
+      line.stop = true;
+    } else if (cursor < end && *cursor == '0') {
+      replyTCode("OSSM Sauce");
+    } else if (cursor < end && *cursor == '1') {
+      replyTCode("OSSM Sauce Firmware");
+    } else if (cursor < end && *cursor == '2') {
+      replyTCode("TCode v0.3");
+    }
+    return;
+  }
+  if (cursor >= end || *cursor != '0')
+    return;  // Only channel 0 of each axis exists
+  cursor++;
+  uint16_t value = parseTCodeValue(cursor, end);
+  uint32_t intervalMs = 0;
+  uint32_t speed = 0;
+  while (cursor < end) {
+    char modifier = toupper(*cursor++);
+    if (modifier == 'I')
+      intervalMs = parseTCodeNumber(cursor, end);
+    else if (modifier == 'S')
+      speed = parseTCodeNumber(cursor, end);
+    else
+      return;
+  }
+  if (type == 'L') {
+    line.hasStroke = true;
+    line.strokeDepth = value;
+    line.strokeIntervalMs = intervalMs;
+    line.strokeSpeed = speed;
+  } else if (type == 'V') {
+    line.hasVibration = true;
+    line.vibrationLevel = value;
+    line.vibrationIntervalMs = intervalMs;
+  }
+}
+
+
+void applyTCodeLine(TCodeLine& line, const TCodeOptions& options) {
+  if (!line.hasStroke && !line.hasVibration && !line.stop)
+    return;
+  xSemaphoreTake(tcodeMutex, portMAX_DELAY);
+  if (motionLocked() || !acquireMotionControl(options.source))
+    line.hasStroke = line.hasVibration = line.stop = false;
+  if (line.stop) {
+    stopMotion();
+    configureOverlay(WAVE_SINE, TCODE_VIBRATION_PERIOD_US, 0, 0);
+  }
+  if (line.hasStroke) {
+    uint32_t durationMs = line.strokeIntervalMs;
+    if (durationMs == 0 && line.strokeSpeed > 0)
+      durationMs = abs(line.strokeDepth - tcodeLastDepth) * 100 / line.strokeSpeed;
+    if (durationMs == 0)
+      durationMs = TCODE_DEFAULT_INTERVAL_MS;
+    durationMs = constrain(durationMs, options.minIntervalMs, options.maxIntervalMs);
+    uint16_t depth = options.inverted ? 10000 - line.strokeDepth : line.strokeDepth;
+    // Same stroke the app sends for bridged T-Code
+    uint8_t strokeData[9];
+    memcpy(strokeData, &durationMs, 4);
+    memcpy(strokeData + 4, &depth, 2);
+    strokeData[6] = min(options.transType, (uint8_t)TRANS_QUINT);
+    strokeData[7] = EASE_IN_OUT;
+    strokeData[8] = 0;
+    startSmoothMove(strokeData);
+    tcodeLastDepth = line.strokeDepth;
+  }
+  if (line.hasVibration) {
+    uint8_t rangePercent = line.vibrationLevel / 100;
+    int32_t durationMs = (line.vibrationLevel == 0) ? 0 : -1;
+    if (line.vibrationIntervalMs > 0 && durationMs != 0)
+      durationMs = line.vibrationIntervalMs;
+    configureOverlay(WAVE_SINE, TCODE_VIBRATION_PERIOD_US, rangePercent, durationMs);
+  }
+  xSemaphoreGive(tcodeMutex);
+  line = {};
+}
+
+
+void processTCode(const char* text, size_t length, const TCodeOptions& options) {
+  const char* end = text + length;
+  const char* cursor = text;
+  TCodeLine line = {};
+  while (cursor < end) {
+    if (*cursor == '\n' || *cursor == '\r') {
+      applyTCodeLine(line, options);
+      cursor++;
+      continue;
+    }
+    if (*cursor == ' ' || *cursor == '\t') {
+      cursor++;
+      continue;
+    }
+    const char* commandEnd = cursor;
+    while (commandEnd < end && !isspace(*commandEnd))
+      commandEnd++;
+    parseTCodeCommand(cursor, commandEnd, line);
+    cursor = commandEnd;
+  }
+  // A message without a trailing newline is a complete line as well
+  if (length > 0 && text[length - 1] != '\n' && text[length - 1] != '\r')
+    applyTCodeLine(line, options);
+}
+
+
+// Serial T-Code, collected a line at a time from the main loop
+void pollTCodeSerial() {
+  while (Serial.available()) {
+    char received = Serial.read();
+    if (received == '\n' || received == '\r') {
+      // A lone 'c' is not T-Code, it opens the configuration console
+      bool openConsole = tcodeSerialLength == 1 && tolower(tcodeSerialLine[0]) == 'c';
+      if (openConsole)
+        openConfigConsole();
+      else if (tcodeSerialLength > 0)
+        processTCode(tcodeSerialLine, tcodeSerialLength, defaultTCodeOptions);
+      tcodeSerialLength = 0;
+      if (openConsole || getSerialMode() != SERIAL_TEXT)
+        return;
+    } else if (tcodeSerialLength < TCODE_LINE_SIZE) {
+      tcodeSerialLine[tcodeSerialLength++] = received;
+    }
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef TCODE_H
+#define TCODE_H
+
+#include <Arduino.h>
+
+// T-Code v0.3 for a single linear axis, parsed in place without allocating.
+// Text arrives in TCODE websocket messages or on the serial port, commands
+// are separated by spaces and take effect together at the end of each line:
+//
+//   L0<value>[I<ms>|S<speed>]  stroke to value over the interval, or at speed
+//                              in 1/10000 of the range per 100 ms
+//   V0<value>[I<ms>]           vibration intensity, layered as an overlay
+//   DSTOP                      stop all motion
+//   DBINARY                    switch the serial port to binary framing
+//   D0 / D1 / D2               identify, firmware and T-Code version (serial)
+//   c                          open the configuration console (serial, alone
+//                              on its line)
+//
+// Values are fractions, L05 and L05000 both mean half of the range. L, V and
+// DSTOP are ignored while motionLocked(), an emergency stop is the override.
+// Other axes and channels are ignored. TCODE messages start with the app's
+// bridge options, [TCODE][trans][inverted][u16 min ms][u16 max ms][text],
+// serial input uses the defaults.
+#define TCODE_LINE_SIZE 128
+#define TCODE_DEFAULT_INTERVAL_MS 100
+#define TCODE_VIBRATION_PERIOD_US 40000
+
+struct TCodeOptions {
+  uint8_t transType;
+  bool inverted;
+  uint16_t minIntervalMs;
+  uint16_t maxIntervalMs;
+  uint8_t source;  // CommandSource the text arrived from
+};
+
+extern const TCodeOptions defaultTCodeOptions;
+
+// Implemented in main.cpp, shared with the SMOOTH_MOVE command
+void startSmoothMove(const uint8_t* strokeData);
+
+// Implemented in main.cpp, true while motion commands are ignored
+bool motionLocked();
+
+// Implemented in main.cpp, stops whatever motion is running
+void stopMotion();
+
+// Called from setup before any task can send T-Code
+void initializeTCode();
+
+// Safe to call from any task
+void processTCode(const char* text, size_t length, const TCodeOptions& options);
+
+void pollTCodeSerial();
+
+#endif
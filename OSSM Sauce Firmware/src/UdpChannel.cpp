@@ -0,0 +1,94 @@
+#include "UdpChannel.h"
+#include "ControllerServer.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+WiFiUDP udpChannel;
+uint16_t udpChannelPort = 0;
+volatile int32_t udpRequestedPort = -1;
+volatile uint8_t udpRequestedSource = SOURCE_APP;
+uint8_t udpChannelSource = SOURCE_APP;
+
+uint8_t udpDatagram[UDP_DATAGRAM_SIZE];
+IPAddress udpSenderAddress;
+uint16_t udpSenderPort = 0;
+uint32_t udpLastSequence = 0;
+uint32_t udpStaleDatagrams = 0;
+uint32_t udpForeignDatagrams = 0;
+
+
+void openUdpChannel(uint16_t port, uint8_t source) {
+  udpRequestedSource = source;
+  udpRequestedPort = port;
+}
+
+
+uint32_t getUdpChannelAddress() {
+  bool open = (udpRequestedPort >= 0) ? udpRequestedPort != 0 : udpChannelPort != 0;
+  return open ? (uint32_t)WiFi.localIP() : 0;
+}
+
+
+void applyUdpChannelRequest() {
+  int32_t port = udpRequestedPort;
+  udpRequestedPort = -1;
+  if (udpChannelPort != 0) {
+    udpChannel.stop();
+    udpChannelPort = 0;
+    if (udpStaleDatagrams)
+      Serial.println("UDP channel dropped " + String(udpStaleDatagrams) + " stale datagrams.");
+    if (udpForeignDatagrams)
+      Serial.println("UDP channel dropped " + String(udpForeignDatagrams) + " datagrams from other senders.");
+  }
+  udpSenderPort = 0;
+  udpStaleDatagrams = 0;
+  udpForeignDatagrams = 0;
+  udpChannelSource = udpRequestedSource;
+  if (port == 0)
+    return;
+  if (!udpChannel.begin(port)) {
+    Serial.println("ERROR: UDP channel failed to open.");
+    return;
+  }
+  udpChannelPort = port;
+  Serial.println("UDP channel open on port " + String(port));
+}
+
+
+void pollUdpChannel() {
+  if (udpRequestedPort >= 0)
+    applyUdpChannelRequest();
+  if (udpChannelPort == 0)
+    return;
+
+  int length;
+  while ((length = udpChannel.parsePacket()) > 0) {
+    if (length < 5 || length > UDP_DATAGRAM_SIZE) {
+      udpChannel.flush();
+      continue;
+    }
+    udpChannel.read(udpDatagram, length);
+    udpChannel.flush();
+
+    uint32_t sequence;
+    memcpy(&sequence, udpDatagram, 4);
+    IPAddress sender = udpChannel.remoteIP();
+    uint16_t senderPort = udpChannel.remotePort();
+    if (udpSenderPort == 0) {
+      // The first sender owns the channel until it is reopened
+      udpSenderAddress = sender;
+      udpSenderPort = senderPort;
+    } else if (sender != udpSenderAddress || senderPort != udpSenderPort) {
+      udpForeignDatagrams++;
+      continue;
+    } else if ((int32_t)(sequence - udpLastSequence) <= 0) {
+      // Wraps at 2^32, anything up to 2^31 behind the last sequence is stale
+      udpStaleDatagrams++;
+      continue;
+    }
+    udpLastSequence = sequence;
+
+    if (isRealtimeCommand(udpDatagram[4]))
+      handleCommand(udpDatagram + 4, length - 4, udpChannelSource);
+  }
+}
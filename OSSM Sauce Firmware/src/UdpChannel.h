@@ -0,0 +1,30 @@
+#ifndef UDP_CHANNEL_H
+#define UDP_CHANNEL_H
+
+#include <Arduino.h>
+
+// Optional UDP channel for real-time commands next to the websocket. Each
+// datagram is a u32 little-endian sequence number followed by one command
+// packet. The first sender's address and port own the channel, datagrams
+// from anywhere else are dropped. A datagram not newer than the last one is
+// dropped, so a late sample never overrides a newer one. Only commands
+// accepted by isRealtimeCommand are decoded, as the source that opened the
+// channel, everything else stays on the reliable channel.
+//
+// Opened by UDP_CHANNEL [u16 port] and closed with port 0. The response
+// value is the device IPv4 address the datagrams go to. Reopening resets
+// the owner and the sequence, so a sender that restarts its count must
+// reopen first. The channel closes when the websocket disconnects.
+#define UDP_DATAGRAM_SIZE 64
+
+// Implemented in main.cpp
+bool isRealtimeCommand(uint8_t commandType);
+
+// Takes effect on the next pollUdpChannel, safe to call from any task
+void openUdpChannel(uint16_t port, uint8_t source);
+
+uint32_t getUdpChannelAddress();
+
+void pollUdpChannel();
+
+#endif
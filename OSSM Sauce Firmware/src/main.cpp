@@ -3,10 +3,24 @@
 #include "freertos/queue.h"
 #include "MotorMovement.h"
 #include "Configuration.h"
+#include "Oscillator.h"
+#include "Pattern.h"
+#include "Recorder.h"
+#include "TCode.h"
+#include "ControllerServer.h"
+#include "SerialTransport.h"
+#include "UdpChannel.h"
+#include "GroupClock.h"
+#include "EmergencyStop.h"
 
 unsigned long playStartTime;
 unsigned long playTimeMs;
 
+// Set when PLAY was scheduled on the group clock, playback then follows
+// the group clock through every CLOCK_SYNC correction
+bool groupPlayback = false;
+int32_t groupPhaseErrorMs = 0;
+
 StrokeCommand activeMove;
 
 StrokeCommand loopPush;
@@ -15,15 +29,37 @@ StrokeCommand loopPull;
 QueueHandle_t moveQueue;
 const char moveQueueSize = 10;
 bool moveQueueIsEmpty = true;
+uint16_t movesReceived = 0;
+const uint32_t moveScheduleSlackMs = 50;
+
+// Every MOVE of the playing path is retained, consumed or not, so SEEK can
+// jump within the window without the app resending it. Entries are
+// addressed by sequence number since the last RESET. The app may restart
+// a path part way through, RESET [u32 path index] gives the index of the
+// first MOVE it sends next so SEEK can answer in path indexes.
+const uint32_t strokeHistorySize = 64;
+StrokeCommand strokeHistory[strokeHistorySize];
+uint32_t historyReceived = 0;   // sequence of the next MOVE received
+uint32_t historyDequeued = 0;   // sequence of the next move moveStart takes
+uint32_t historyPathStart = 0;  // sequence of the playing path's first move
+uint32_t historyPathIndex = 0;  // path index of the move at historyPathStart
+int32_t seekResult = -1;
 
 QueueHandle_t positionQueue;
 const char positionQueueSize = 50;
 bool positionQueueIsEmpty = true;
 int previousTargetPosition;
 
+// SMOOTH_MOVE and T-Code start smooth moves from the websocket, controller
+// server and UDP tasks while the loop plays them, the command is only
+// replaced or read as a whole under smoothMoveMux
 StrokeCommand smoothMoveCommand;
 unsigned long smoothMoveStartTime;
 bool smoothMoveActive = false;
+portMUX_TYPE smoothMoveMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Last time the motor was commanded or still stepping
+unsigned long lastMotionMs = 0;
 
 enum CommandType:byte {
   RESPONSE,
@@ -42,19 +78,134 @@ enum CommandType:byte {
   SET_HOMING_SPEED,
   SET_HOMING_TRIGGER,
   SMOOTH_MOVE,  // 0x0F
+  VIBRATE_TABLE,
+  CALIBRATE_VIBRATION,
+  OVERLAY,
+  PATTERN_UPLOAD,
+  PATTERN_CONTROL,
+  SEEK,
+  RECORDER_DUMP,
+  TCODE,
+  SERIAL_MODE,
+  UDP_CHANNEL,
+  CLOCK_SYNC,
+  SCHEDULE,
+  RECALIBRATE,
+  AUTOTUNE,
+  ESTOP,
 };
 
-struct Response {
+// Every response carries the move queue credit state so the app can keep
+// the queue full without ever overrunning it.
+struct __attribute__((packed)) Response {
   CommandType commandType = RESPONSE;
   CommandType responseType;
+  uint8_t moveCredits;     // Free slots in moveQueue
+  uint16_t movesReceived;  // MOVE packets received since last RESET (wrapping)
+  int32_t value;           // State reported for the response type
 };
 
 
+int32_t getResponseValue(CommandType responseType) {
+  switch (responseType) {
+    case VIBRATE:
+      return vibration.deliveredRange;
+    case CALIBRATE_VIBRATION:
+      return CALIBRATION_POINTS;
+    case SEEK:
+      return seekResult;
+    case UDP_CHANNEL:
+      return getUdpChannelAddress();
+    case CLOCK_SYNC:
+      return groupPhaseErrorMs;
+    case RECALIBRATE:
+      return recalibrateStage;
+    case AUTOTUNE:
+      return autoTuneStage;
+    case ESTOP:
+      return getEmergencyStopResponse();
+    case SET_SPEED_LIMIT:
+      return globalSpeedLimitHz;
+    case SET_GLOBAL_ACCELERATION:
+      return globalAcceleration;
+    default:
+      return 0;
+  }
+}
+
+
+// Responses are queued and sent by responseTask so the motion loop never
+// waits on the network. A response type already waiting to be sent is not
+// queued again, the credit state is read when the response goes out.
+QueueHandle_t responseQueue;
+const char responseQueueSize = 16;
+const TickType_t responseSendTimeout = pdMS_TO_TICKS(50);
+portMUX_TYPE responseMux = portMUX_INITIALIZER_UNLOCKED;
+uint64_t pendingResponses = 0;
+
+void sendResponse(CommandType responseCommand) {
+  uint64_t responseBit = 1ULL << responseCommand;
+  bool alreadyPending;
+  portENTER_CRITICAL(&responseMux);
+  alreadyPending = pendingResponses & responseBit;
+  pendingResponses |= responseBit;
+  portEXIT_CRITICAL(&responseMux);
+  if (alreadyPending)
+    return;
+  if (!xQueueSend(responseQueue, &responseCommand, 0)) {
+    portENTER_CRITICAL(&responseMux);
+    pendingResponses &= ~responseBit;
+    portEXIT_CRITICAL(&responseMux);
+    Serial.println("ERROR: Response queue full.");
+  }
+}
+
+
+void responseTask(void *parameter) {
+  CommandType responseCommand;
+  while (true) {
+    if (!xQueueReceive(responseQueue, &responseCommand, portMAX_DELAY))
+      continue;
+    portENTER_CRITICAL(&responseMux);
+    pendingResponses &= ~(1ULL << responseCommand);
+    portEXIT_CRITICAL(&responseMux);
+    bool appConnected = esp_websocket_client_is_connected(wsClient);
+    if (responseCommand == RECORDER_DUMP) {
+      if (appConnected)
+        sendRecording(RECORDER_DUMP);
+      continue;
+    }
+
+    Response responseMessage;
+    int messageSize = sizeof(responseMessage);
+    responseMessage.responseType = responseCommand;
+    responseMessage.moveCredits = uxQueueSpacesAvailable(moveQueue);
+    responseMessage.movesReceived = movesReceived;
+    responseMessage.value = getResponseValue(responseCommand);
+    char message[messageSize];
+    memcpy(message, (char*)&responseMessage, messageSize);
+    controllerBroadcast((uint8_t*)message, messageSize);
+    serialSend((uint8_t*)message, messageSize);
+    if (appConnected && esp_websocket_client_send_bin(wsClient, message, messageSize, responseSendTimeout) < 0)
+      Serial.println("ERROR: Response send timed out.");
+  }
+}
+
+
 void moveStart() {
   activeMove.active = false;
   short lastTargetDepth = activeMove.depth;
-  if (!xQueueReceive(moveQueue, &activeMove, (TickType_t)10))
+  uint32_t lastEndTimeMs = activeMove.endTimeMs;
+  if (!xQueueReceive(moveQueue, &activeMove, (TickType_t)10)) {
     Serial.println("ERROR: Queue empty.");
+  } else {
+    sendResponse(MOVE); // A queue slot was freed, return the credit
+    if (activeMove.endTimeMs == 0) {
+      historyPathStart = historyDequeued;
+      historyPathIndex = 0;
+    }
+    historyDequeued++;
+  }
   if (activeMove.endTimeMs == 0 && uxQueueSpacesAvailable(moveQueue) < moveQueueSize) { // start of next path
     playTimeMs = 0;
     playStartTime = millis();
@@ -62,32 +213,202 @@ void moveStart() {
     return;
   short constrainedPosition = constrain(activeMove.depth, 0, 10000);
   activeMove.targetPosition = map(constrainedPosition, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
-  activeMove.playTimeStartedMs = playTimeMs;
+  // Chain from the scheduled end of the previous move so loop latency is not
+  // added to every stroke and the script keeps its exact timing
+  if (playTimeMs - lastEndTimeMs <= moveScheduleSlackMs)
+    activeMove.playTimeStartedMs = lastEndTimeMs;
+  else
+    activeMove.playTimeStartedMs = playTimeMs;
   u32_t durationMs = activeMove.endTimeMs - activeMove.playTimeStartedMs;
-  activeMove.durationReciprocal = 1.0 / durationMs;
+  activeMove.durationReciprocal = MotionMath::reciprocal(durationMs);
   activeMove.baseSpeedHz = getMoveBaseSpeedHz(activeMove, durationMs);
+  prepareCurve(&activeMove);
   activeMove.active = true;
 }
 
 
-void sendResponse(CommandType responseCommand) {
-  Response responseMessage;
-  int messageSize = sizeof(responseMessage);
-  responseMessage.responseType = responseCommand;
-  char message[messageSize];
-  memcpy(message, (char*)&responseMessage, messageSize);
-  esp_websocket_client_send_bin(wsClient, message, messageSize, portMAX_DELAY);
+void startSmoothMove(const uint8_t* strokeData) {
+  StrokeCommand command = {};
+  memcpy(&command, strokeData, 9);
+  short constrainedPosition = constrain(command.depth, 0, 10000);
+  command.targetPosition = map(constrainedPosition, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
+  command.endTimeMs = constrain(command.endTimeMs, 20, 3600000);
+  command.durationReciprocal = MotionMath::reciprocal(command.endTimeMs);
+  command.baseSpeedHz = getMoveBaseSpeedHz(command, command.endTimeMs);
+  prepareCurve(&command);
+  portENTER_CRITICAL(&smoothMoveMux);
+  smoothMoveCommand = command;
+  smoothMoveStartTime = millis();
+  smoothMoveActive = true;
+  movementMode = MODE_SMOOTH_MOVE;
+  portEXIT_CRITICAL(&smoothMoveMux);
+}
+
+
+StrokeCommand* historyEntry(uint32_t sequence) {
+  return &strokeHistory[sequence % strokeHistorySize];
+}
+
+
+// Rebuilds the move queue from the first retained move still playing at
+// timeMs. Returns the path index of the next move the app should send, or
+// -1 when timeMs is outside the window and the app has to resend.
+int32_t seekStrokeHistory(uint32_t timeMs) {
+  uint32_t first = historyPathStart;
+  if (historyReceived > strokeHistorySize)
+    first = max(first, historyReceived - strokeHistorySize);
+  uint32_t end = max(first, historyPathStart + 1);
+  while (end < historyReceived && historyEntry(end)->endTimeMs != 0)
+    end++;
+
+  uint32_t low = first;
+  uint32_t high = end;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (historyEntry(middle)->endTimeMs > timeMs)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  if (low == first || low == end)
+    return -1;
+
+  // Moves past the queue capacity are dropped and resent by the app
+  xQueueReset(moveQueue);
+  uint32_t sequence = low;
+  while (sequence < end && sequence - low < moveQueueSize) {
+    xQueueSend(moveQueue, historyEntry(sequence), 0);
+    sequence++;
+  }
+  historyReceived = sequence;
+  historyDequeued = low;
+
+  // The move ending at or before timeMs stands in as the finished one so
+  // PLAY picks up the partial segment through moveStart
+  memcpy(&activeMove, historyEntry(low - 1), 9);
+  activeMove.active = false;
+  moveQueueIsEmpty = false;
+  playTimeMs = timeMs;
+  return historyPathIndex + sequence - historyPathStart;
+}
+
+
+// T-Code DSTOP, decelerates to a stop. Setting the mode alone would leave
+// a running move going with nothing servicing it.
+void stopMotion() {
+  movementMode = MODE_IDLE;
+  smoothMoveActive = false;
+  stepper->stopMove();
+}
+
+
+// Motion stops where it is. Every stage change is reported as a RECALIBRATE
+// response, the app resyncs playback once it reports done.
+void beginRecalibration() {
+  smoothMoveActive = false;
+  startRecalibration();
+  movementMode = MODE_RECALIBRATE;
+  sendResponse(RECALIBRATE);
+}
+
+
+// Called first thing in the loop after a trigger, the driver is already off
+void haltForEmergencyStop() {
+  stepper->forceStop();
+  movementMode = MODE_IDLE;
+  smoothMoveActive = false;
+  activeMove.active = false;
+  xQueueReset(moveQueue);
+  xQueueReset(positionQueue);
+  moveQueueIsEmpty = true;
+  positionQueueIsEmpty = true;
+  clearScheduledCommands();
+  emergencyStopHalted();
+  sendResponse(ESTOP);
+}
+
+
+bool motionLocked() {
+  return movementMode == MODE_HOMING
+      || movementMode == MODE_RECALIBRATE
+      || movementMode == MODE_AUTOTUNE
+      || emergencyStopLatched();
 }
 
 
-void parseMessage(esp_websocket_event_data_t *data) {
-  byte* message = (byte*)data->data_ptr;
-  size_t messageLength = data->data_len;
+// Commands that move the motor, only accepted from the source in control
+bool isMotionCommand(CommandType commandType) {
+  switch (commandType) {
+    case RESPONSE:
+    case CONNECTION:
+    case SET_SPEED_LIMIT:
+    case SET_GLOBAL_ACCELERATION:
+    case SET_RANGE_LIMIT:
+    case SET_HOMING_SPEED:
+    case SET_HOMING_TRIGGER:
+    case VIBRATE_TABLE:
+    case RECORDER_DUMP:
+    case SERIAL_MODE:
+    case UDP_CHANNEL:
+    case CLOCK_SYNC:
+    case SCHEDULE:
+      return false;
+    default:
+      return true;
+  }
+}
+
+
+// Commands where a newer packet replaces any older one, safe to receive
+// out of order or not at all over the UDP channel
+bool isRealtimeCommand(uint8_t commandType) {
+  return commandType == POSITION || commandType == VIBRATE;
+}
 
-  if (movementMode == MODE_HOMING)
+
+// Modes PLAY may enter directly. Homing, recalibration, auto-tune and
+// vibration calibration need their own setup and are only started by
+// their commands, a pattern only once one is loaded.
+bool isPlayableMode(uint8_t mode) {
+  switch (mode) {
+    case MODE_IDLE:
+    case MODE_MOVE:
+    case MODE_POSITION:
+    case MODE_LOOP:
+    case MODE_VIBRATE:
+    case MODE_SMOOTH_MOVE:
+      return true;
+    case MODE_PATTERN:
+      return patternLoaded();
+    default:
+      return false;
+  }
+}
+
+
+void handleCommand(byte* message, size_t messageLength, uint8_t source) {
+  if (messageLength == 0)
     return;
-  
+  recordCommand(message, messageLength, playTimeMs, moveQueueSize - uxQueueSpacesAvailable(moveQueue));
   CommandType commandType = static_cast<CommandType>(message[0]);
+
+  // ESTOP [0] clears the stop, any other ESTOP triggers it from any source
+  if (commandType == ESTOP) {
+    if (messageLength == 2 && message[1] == 0) {
+      if (emergencyStopLatched() && clearEmergencyStop())
+        beginRecalibration();
+      sendResponse(ESTOP);
+    } else {
+      triggerEmergencyStop();
+    }
+    return;
+  }
+
+  if (movementMode == MODE_HOMING || movementMode == MODE_RECALIBRATE || movementMode == MODE_AUTOTUNE)
+    return;
+  
+  if (isMotionCommand(commandType) && (emergencyStopLatched() || !acquireMotionControl(source)))
+    return;
   switch (commandType) {
     case RESPONSE:
       break;
@@ -95,8 +416,13 @@ void parseMessage(esp_websocket_event_data_t *data) {
     case MOVE: {
       if (messageLength != 10)
         break;
-      if(!xQueueSend(moveQueue, &(message[1]), (TickType_t)10))
+      movesReceived++;
+      if(!xQueueSend(moveQueue, &(message[1]), (TickType_t)10)) {
         Serial.println("ERROR: Failed to add move command to queue. Is queue full?");
+      } else {
+        memcpy(&strokeHistory[historyReceived % strokeHistorySize], message + 1, 9);
+        historyReceived++;
+      }
       if (moveQueueIsEmpty)
         moveStart();
       moveQueueIsEmpty = false;
@@ -114,15 +440,19 @@ void parseMessage(esp_websocket_event_data_t *data) {
         short constrainedPosition = constrain(loopPush.depth, 0, 10000);
         //loopPush.targetPosition = map(constrainedPosition, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
         loopPush.targetPosition = rangeLimitUserMax;
-        loopPush.durationReciprocal = 1.0 / loopPush.endTimeMs;
+        loopPush.durationReciprocal = MotionMath::reciprocal(loopPush.endTimeMs);
         loopPush.baseSpeedHz = getMoveBaseSpeedHz(loopPush, loopPush.endTimeMs, true);
+        prepareCurve(&loopPush);
+        loopPush.startPosition = rangeLimitUserMin;
       }
       if (loopPull.endTimeMs != 0) {
         short constrainedPosition = constrain(loopPull.depth, 0, 10000);
         //loopPull.targetPosition = map(constrainedPosition, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
         loopPull.targetPosition = rangeLimitUserMin;
-        loopPull.durationReciprocal = 1.0 / loopPull.endTimeMs;
+        loopPull.durationReciprocal = MotionMath::reciprocal(loopPull.endTimeMs);
         loopPull.baseSpeedHz = getMoveBaseSpeedHz(loopPull, loopPull.endTimeMs, true);
+        prepareCurve(&loopPull);
+        loopPull.startPosition = rangeLimitUserMax;
       }
       movementMode = MODE_LOOP;
       break;
@@ -150,21 +480,32 @@ void parseMessage(esp_websocket_event_data_t *data) {
     }
 
     case VIBRATE: {
-      if (messageLength != 13)
+      // Optional: waveform (byte 13) and period in microseconds (bytes 14-17)
+      if (messageLength != 13 && messageLength != 14 && messageLength != 18)
         break;
       memcpy(&vibration, message + 1, 12);
 
+      Waveform waveform = (messageLength >= 14) ? static_cast<Waveform>(message[13]) : WAVE_SQUARE;
+      uint32_t periodUs = vibration.halfPeriodMs * 2000;
+      if (messageLength == 18)
+        memcpy(&periodUs, message + 14, 4);
+      oscillatorConfigure(waveform, periodUs);
+      float frequencyHz = 1000000.0f / oscillatorPeriodUs();
+
+      // Limit to the range the stepper was measured to reach at this frequency
       int constrainedPosition = constrain(vibration.position, 0, 10000);
       vibration.origin = map(constrainedPosition, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
       uint32_t totalRange = abs(rangeLimitUserMax - rangeLimitUserMin);
       uint32_t vibrationRange = vibration.rangePercent * 0.01 * totalRange;
+      vibrationRange = min(vibrationRange, getAchievableVibrationRange(frequencyHz));
       long vibrationEndpoint = vibration.origin + vibrationRange;
       vibration.crest = constrain(vibrationEndpoint, rangeLimitUserMin, rangeLimitUserMax);
+      vibrationRange = abs(vibration.crest - vibration.origin);
+      vibration.deliveredRange = totalRange ? (uint64_t)vibrationRange * 10000 / totalRange : 0;
+      sendResponse(VIBRATE);
 
-      float halfPeriodReciprocal = 1 / float(vibration.halfPeriodMs);
-      uint32_t duration = 1000 * halfPeriodReciprocal;
       float waveformSpeedScaling = vibration.speedScaling * 0.01;
-      uint32_t newSpeed = vibrationRange * duration * waveformSpeedScaling;
+      uint32_t newSpeed = vibrationRange * oscillatorPeakSlope() * frequencyHz * waveformSpeedScaling;
       stepper->setSpeedInHz(min(newSpeed, globalSpeedLimitHz));
 
       if (vibration.duration > 0) {
@@ -179,15 +520,66 @@ void parseMessage(esp_websocket_event_data_t *data) {
 
       processSafeAccel();
       movementMode = MODE_VIBRATE;
+      oscillatorStart();
+      break;
+    }
+
+    case OVERLAY: {
+      if (messageLength != 11)
+        break;
+      Waveform waveform = static_cast<Waveform>(message[1]);
+      uint32_t periodUs;
+      int32_t duration;
+      memcpy(&periodUs, message + 2, 4);
+      memcpy(&duration, message + 7, 4);
+      configureOverlay(waveform, periodUs, message[6], duration);
+      break;
+    }
+
+    case PATTERN_UPLOAD: {
+      if (movementMode == MODE_PATTERN)
+        movementMode = MODE_IDLE;
+      if (!loadPattern(message + 1, messageLength - 1))
+        Serial.println("ERROR: Invalid pattern program.");
+      sendResponse(PATTERN_UPLOAD);
+      break;
+    }
+
+    case PATTERN_CONTROL: {
+      if (messageLength != 5)
+        break;
+      uint16_t tempoPercent;
+      uint16_t depthScale;
+      memcpy(&tempoPercent, message + 1, 2);
+      memcpy(&depthScale, message + 3, 2);
+      setPatternControl(tempoPercent, depthScale);
+      break;
+    }
+
+    case CALIBRATE_VIBRATION: {
+      startVibrationCalibration();
+      break;
+    }
+
+    case VIBRATE_TABLE: {
+      if (messageLength < 2 || messageLength != 2 + message[1])
+        break;
+      if (!oscillatorSetTable(message + 2, message[1]))
+        Serial.println("ERROR: Invalid waveform table length.");
       break;
     }
 
     case PLAY: {
+      if (messageLength < 2 || !isPlayableMode(message[1])) {
+        Serial.println("ERROR: PLAY mode not playable.");
+        break;
+      }
       memcpy(&movementMode, message + 1, 1);
       if (messageLength == 6) {
         memcpy(&playTimeMs, message + 2, 4);
       }
-      playStartTime = millis() - playTimeMs;
+      playStartTime = millis() - scheduledLateMs - playTimeMs;
+      groupPlayback = runningScheduledCommand;
       break;
     }
 
@@ -202,6 +594,100 @@ void parseMessage(esp_websocket_event_data_t *data) {
       xQueueReset(moveQueue);
       xQueueReset(positionQueue);
       moveQueueIsEmpty = true;
+      movesReceived = 0;
+      historyReceived = 0;
+      historyDequeued = 0;
+      historyPathStart = 0;
+      historyPathIndex = 0;
+      if (messageLength == 5)
+        memcpy(&historyPathIndex, message + 1, 4);
+      clearScheduledCommands();
+      sendResponse(RESET);
+      break;
+    }
+
+    case SEEK: {
+      if (messageLength != 7)
+        break;
+      uint32_t timeMs;
+      uint16_t depth;
+      memcpy(&timeMs, message + 1, 4);
+      memcpy(&depth, message + 5, 2);
+      seekResult = seekStrokeHistory(timeMs);
+      sendResponse(SEEK);
+      if (seekResult < 0)
+        break;
+      int constrainedPosition = constrain(depth, 0, 10000);
+      homingTargetPosition = map(constrainedPosition, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
+      movementMode = MODE_HOMING;
+      break;
+    }
+
+    case RECORDER_DUMP: {
+      sendResponse(RECORDER_DUMP);
+      break;
+    }
+
+    case SERIAL_MODE: {
+      if (messageLength != 6)
+        break;
+      uint32_t baud;
+      memcpy(&baud, message + 2, 4);
+      setSerialMode(message[1] == SERIAL_BINARY ? SERIAL_BINARY : SERIAL_TEXT, baud);
+      break;
+    }
+
+    case UDP_CHANNEL: {
+      if (messageLength != 3)
+        break;
+      uint16_t port;
+      memcpy(&port, message + 1, 2);
+      openUdpChannel(port, source);
+      sendResponse(UDP_CHANNEL);
+      break;
+    }
+
+    case CLOCK_SYNC: {
+      if (messageLength != 5)
+        break;
+      uint32_t groupTimeMs;
+      memcpy(&groupTimeMs, message + 1, 4);
+      groupPhaseErrorMs = syncGroupClock(groupTimeMs);
+      if (groupPlayback)
+        playStartTime -= groupPhaseErrorMs;
+      sendResponse(CLOCK_SYNC);
+      break;
+    }
+
+    case SCHEDULE: {
+      if (messageLength < 6)
+        break;
+      uint32_t executeAtMs;
+      memcpy(&executeAtMs, message + 1, 4);
+      scheduleCommand(message + 5, messageLength - 5, executeAtMs, source);
+      break;
+    }
+
+    case RECALIBRATE: {
+      beginRecalibration();
+      break;
+    }
+
+    case AUTOTUNE: {
+      // AUTOTUNE [0] clears the tuned limits instead
+      if (messageLength == 2 && message[1] == 0) {
+        tunedSpeedLimitHz = 0;
+        tunedAcceleration = 0;
+        markSettingsChanged();
+        break;
+      }
+      if (!startAutoTune()) {
+        sendResponse(AUTOTUNE);
+        break;
+      }
+      smoothMoveActive = false;
+      movementMode = MODE_AUTOTUNE;
+      sendResponse(AUTOTUNE);
       break;
     }
 
@@ -215,6 +701,9 @@ void parseMessage(esp_websocket_event_data_t *data) {
     }
 
     case CONNECTION: {
+      // Clamped to the configured priority, a client can only give way
+      if (messageLength == 2)
+        setSourcePriority(source, message[1]);
       sendResponse(CONNECTION);
       break;
     }
@@ -223,6 +712,9 @@ void parseMessage(esp_websocket_event_data_t *data) {
       int speedLimit;
       memcpy(&speedLimit, message + 1, 4);
       globalSpeedLimitHz = max(speedLimit, 0);
+      if (tunedSpeedLimitHz)
+        globalSpeedLimitHz = min(globalSpeedLimitHz, tunedSpeedLimitHz);
+      markSettingsChanged();
       break;
     }
 
@@ -230,6 +722,9 @@ void parseMessage(esp_websocket_event_data_t *data) {
       int acceleration;
       memcpy(&acceleration, message + 1, 4);
       globalAcceleration = max(acceleration, 0);
+      if (tunedAcceleration)
+        globalAcceleration = min(globalAcceleration, tunedAcceleration);
+      markSettingsChanged();
       break;
     }
 
@@ -237,25 +732,30 @@ void parseMessage(esp_websocket_event_data_t *data) {
       short rangeLimitInput;
       memcpy(&rangeLimitInput, message + 2, 2);
       rangeLimitInput = constrain(rangeLimitInput, 0, 10000);
-      rangeLimitInput = map(rangeLimitInput, 0, 10000, rangeLimitHardMin, rangeLimitHardMax);
       byte selectedRange = message[1];
       enum {MIN_RANGE, MAX_RANGE};
       switch (selectedRange) {
         case MIN_RANGE:
-          rangeLimitUserMin = rangeLimitInput;
+          rangeLimitUserMinInput = rangeLimitInput;
           break;
         case MAX_RANGE:
-          rangeLimitUserMax = rangeLimitInput;
+          rangeLimitUserMaxInput = rangeLimitInput;
           break;
       }
+      applyStoredRangeLimits();
+      markSettingsChanged();
       if (movementMode == MODE_LOOP) {
         if (loopPush.endTimeMs != 0) {
           loopPush.targetPosition = rangeLimitUserMax;
           loopPush.baseSpeedHz = getMoveBaseSpeedHz(loopPush, loopPush.endTimeMs, true);
+        prepareCurve(&loopPush);
+        loopPush.startPosition = rangeLimitUserMin;
         }
         if (loopPull.endTimeMs != 0) {
           loopPull.targetPosition = rangeLimitUserMin;
           loopPull.baseSpeedHz = getMoveBaseSpeedHz(loopPull, loopPull.endTimeMs, true);
+        prepareCurve(&loopPull);
+        loopPull.startPosition = rangeLimitUserMax;
         }
       }
       break;
@@ -265,6 +765,7 @@ void parseMessage(esp_websocket_event_data_t *data) {
       u32_t homingSpeedInputHz;
       memcpy(&homingSpeedInputHz, message + 1, 4);
       homingSpeedHz = min(globalSpeedLimitHz, homingSpeedInputHz);
+      markSettingsChanged();
       break;
     }
 
@@ -272,22 +773,27 @@ void parseMessage(esp_websocket_event_data_t *data) {
       float homingTriggerInput;
       memcpy(&homingTriggerInput, message + 1, 4);
       powerAvgRangeMultiplier = constrain(homingTriggerInput, 0.1, 10) ;
-      preferences.putFloat("homing_trigger", powerAvgRangeMultiplier);
+      markSettingsChanged();
       break;
     }
 
     case SMOOTH_MOVE: {
       if (messageLength != 10)
         break;
-      memcpy(&smoothMoveCommand, message + 1, 9);
-      short constrainedPosition = constrain(smoothMoveCommand.depth, 0, 10000);
-      smoothMoveCommand.targetPosition = map(constrainedPosition, 0, 10000, rangeLimitUserMin, rangeLimitUserMax);
-      smoothMoveCommand.endTimeMs = constrain(smoothMoveCommand.endTimeMs, 20, 3600000);
-      smoothMoveCommand.durationReciprocal = 1.0 / smoothMoveCommand.endTimeMs;
-      smoothMoveCommand.baseSpeedHz = getMoveBaseSpeedHz(smoothMoveCommand, smoothMoveCommand.endTimeMs);
-      smoothMoveStartTime = millis();
-      smoothMoveActive = true;
-      movementMode = MODE_SMOOTH_MOVE;
+      startSmoothMove(message + 1);
+      break;
+    }
+
+    case TCODE: {
+      if (messageLength < 7)
+        break;
+      TCodeOptions options;
+      options.transType = message[1];
+      options.inverted = message[2];
+      memcpy(&options.minIntervalMs, message + 3, 2);
+      memcpy(&options.maxIntervalMs, message + 5, 2);
+      options.source = source;
+      processTCode((const char*)message + 7, messageLength - 7, options);
       break;
     }
   }
@@ -300,14 +806,18 @@ static void websocket_event_handler(void *arg, esp_event_base_t event_base, int3
     case WEBSOCKET_EVENT_CONNECTED:
       Serial.println("Connected to WebSocket Server");
       setLEDStatus(LED_CONNECTED);  // Update LED status
+      // Nothing scheduled by an earlier session may fire in this one
+      clearScheduledCommands();
       sendResponse(CONNECTION);
       break;
     case WEBSOCKET_EVENT_DISCONNECTED:
       Serial.println("Disconnected from WebSocket Server");
       setLEDStatus(LED_ERROR);  // Update LED status
+      openUdpChannel(0, SOURCE_APP);
+      clearScheduledCommands();
       break;
     case WEBSOCKET_EVENT_DATA:
-      parseMessage(data);
+      handleCommand((byte*)data->data_ptr, data->data_len, SOURCE_APP);
       break;
   }
 }
@@ -318,7 +828,14 @@ void setup() {
   Serial.flush();
 
   initializeConfiguration();
-  checkForConfigMode();
+
+  // Created before connecting, responses report the queue's free slots
+  moveQueue = xQueueCreate(moveQueueSize, 9);
+  positionQueue = xQueueCreate(positionQueueSize, 4);
+
+  responseQueue = xQueueCreate(responseQueueSize, sizeof(CommandType));
+  initializeTCode();
+  xTaskCreatePinnedToCore(responseTask, "responses", 4096, NULL, 1, NULL, 0);
   
   connectToWiFi();
   delay(1000);
@@ -327,6 +844,8 @@ void setup() {
   esp_websocket_register_events(wsClient, WEBSOCKET_EVENT_ANY, websocket_event_handler, (void *)wsClient);
 
   initializeMotor();
+  initializeOscillator();
+  initializeControllerServer();
 
   Serial.println("");
   Serial.println("");
@@ -340,10 +859,16 @@ void setup() {
   Serial.println(" Firmware v1.4.3");
   Serial.println("");
 
-  moveQueue = xQueueCreate(moveQueueSize, 9);
-  positionQueue = xQueueCreate(positionQueueSize, 4);
+#ifdef MOTION_MATH_BENCHMARK
+  benchmarkMotionMath();
+#endif
 
-  sensorlessHoming();
+  if (homingBySwitch)
+    limitSwitchHoming();
+  else
+    sensorlessHoming();
+  applyStoredRangeLimits();
+  initializeEmergencyStop();
 
   stepper->setAcceleration(globalAcceleration);
   
@@ -355,10 +880,30 @@ void setup() {
 
 
 void loop() {
+  if (emergencyStopPending())
+    haltForEmergencyStop();
+
+  pollSerial();
+  pollUdpChannel();
+  runScheduledCommands();
+
+  bool motorDriven = movementMode != MODE_IDLE
+      && movementMode != MODE_RECALIBRATE
+      && movementMode != MODE_AUTOTUNE
+      && movementMode != MODE_CALIBRATE_VIBRATION;
+  if (monitorStall(motorDriven))
+    beginRecalibration();
 
-  updateLED();
+  if (movementMode != MODE_IDLE || stepper->isRunning())
+    lastMotionMs = millis();
 
   switch (movementMode) {
+    case MODE_IDLE: {
+      if (millis() - lastMotionMs >= SETTINGS_QUIET_MS)
+        writeBackSettings();
+      break;
+    }
+
     case MODE_MOVE: {
       playTimeMs = millis() - playStartTime;
       if (playTimeMs >= activeMove.endTimeMs)
@@ -382,13 +927,55 @@ void loop() {
     }
 
     case MODE_VIBRATE: {
-      unsigned long currentMs = millis();
-      if (currentMs - vibration.currentMs >= vibration.halfPeriodMs) {
-        vibration.currentMs = currentMs;
-        vibration.direction = (vibration.direction == IN) ? OUT : IN;
-        stepper->moveTo((vibration.direction == IN) ? vibration.origin : vibration.crest);
+      // Waveform is driven by the oscillator task
+      if (vibration.timed && millis() >= vibration.endMs) {
+        movementMode = MODE_IDLE;
+      }
+      break;
+    }
+
+    case MODE_PATTERN: {
+      processPattern();
+      break;
+    }
+
+    case MODE_CALIBRATE_VIBRATION: {
+      if (processVibrationCalibration())
+        sendResponse(CALIBRATE_VIBRATION);
+      break;
+    }
+
+    case MODE_RECALIBRATE: {
+      if (!processRecalibration())
+        break;
+      sendResponse(RECALIBRATE);
+      if (recalibrateStage == RECALIBRATE_DONE) {
+        applyStoredRangeLimits();
+        stepper->setAcceleration(globalAcceleration);
+        stepper->moveTo(rangeLimitUserMin);
+        movementMode = MODE_IDLE;
+      } else if (recalibrateStage == RECALIBRATE_FAILED) {
+        stepper->setAcceleration(globalAcceleration);
+        movementMode = MODE_IDLE;
+      }
+      break;
+    }
+
+    case MODE_AUTOTUNE: {
+      if (!processAutoTune())
+        break;
+      if (autoTuneStage == AUTOTUNE_DONE) {
+        globalSpeedLimitHz = tunedSpeedLimitHz;
+        globalAcceleration = tunedAcceleration;
+        markSettingsChanged();
+        sendResponse(SET_SPEED_LIMIT);
+        sendResponse(SET_GLOBAL_ACCELERATION);
       }
-      if (vibration.timed && currentMs >= vibration.endMs) {
+      sendResponse(AUTOTUNE);
+      if (autoTuneStage == AUTOTUNE_DONE || autoTuneStage == AUTOTUNE_FAILED) {
+        stepper->setAcceleration(globalAcceleration);
+        stepper->setSpeedInHz(min(homingSpeedHz, globalSpeedLimitHz));
+        stepper->moveTo(rangeLimitUserMin);
         movementMode = MODE_IDLE;
       }
       break;
@@ -406,16 +993,21 @@ void loop() {
     }
 
     case MODE_SMOOTH_MOVE: {
-      if (smoothMoveActive) {
-        unsigned long elapsed = millis() - smoothMoveStartTime;
-        if (elapsed >= smoothMoveCommand.endTimeMs) {
-          smoothMoveActive = false;
-          movementMode = MODE_IDLE;
-          sendResponse(SMOOTH_MOVE);
-        } else {
-          processStroke(&smoothMoveCommand, elapsed);
-        }
+      // Played from a copy, a newer move may replace the command meanwhile
+      portENTER_CRITICAL(&smoothMoveMux);
+      StrokeCommand stroke = smoothMoveCommand;
+      bool active = smoothMoveActive;
+      unsigned long elapsed = millis() - smoothMoveStartTime;
+      bool finished = active && elapsed >= smoothMoveCommand.endTimeMs;
+      if (finished) {
+        smoothMoveActive = false;
+        movementMode = MODE_IDLE;
       }
+      portEXIT_CRITICAL(&smoothMoveMux);
+      if (finished)
+        sendResponse(SMOOTH_MOVE);
+      else if (active)
+        processStroke(&stroke, elapsed);
       break;
     }
 
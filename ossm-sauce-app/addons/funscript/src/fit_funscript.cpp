@@ -0,0 +1,58 @@
+// Command line front end for the fitter, writes a marker file keyed by
+// milliseconds that the app loads like any other path:
+//   fit_funscript <in.funscript> <out.json> [tolerance]
+
+#include "funscript.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: fit_funscript <in.funscript> <out.json> [tolerance]\n");
+    return 1;
+  }
+  float tolerance = (argc > 3) ? strtof(argv[3], nullptr) : funscript::DEFAULT_TOLERANCE;
+
+  FILE* input = fopen(argv[1], "rb");
+  if (!input) {
+    fprintf(stderr, "Error: Failed to read %s\n", argv[1]);
+    return 1;
+  }
+  std::vector<char> text;
+  char buffer[65536];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), input)) > 0)
+    text.insert(text.end(), buffer, buffer + read);
+  fclose(input);
+
+  std::vector<funscript::Action> actions;
+  if (!funscript::readActions(text.data(), text.size(), actions)) {
+    fprintf(stderr, "No actions data found in the funscript\n");
+    return 1;
+  }
+  std::vector<funscript::Segment> segments = funscript::fit(actions, tolerance);
+
+  FILE* output = fopen(argv[2], "wb");
+  if (!output) {
+    fprintf(stderr, "Error: Failed to write %s\n", argv[2]);
+    return 1;
+  }
+  fprintf(output, "{\"meta\":{\"frame_rate\":1000},\"markers\":{");
+  // The app starts every path from a marker at 0
+  if (segments[0].at != 0)
+    fprintf(output, "\"0\":[%.4f,1,2,0],", actions[0].depth);
+  for (size_t i = 0; i < segments.size(); i++) {
+    const funscript::Segment& segment = segments[i];
+    fprintf(output, "%s\"%lld\":[%.4f,%u,%u,%u]", i ? "," : "", (long long)segment.at,
+        segment.depth, segment.trans, segment.ease, segment.auxiliary);
+  }
+  fprintf(output, "}}");
+  fclose(output);
+
+  printf("%zu actions fitted to %zu segments at tolerance %.3f\n",
+      actions.size(), segments.size() - 1, tolerance);
+  return 0;
+}
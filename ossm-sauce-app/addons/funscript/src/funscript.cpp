@@ -0,0 +1,611 @@
+#include "funscript.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace funscript {
+
+namespace {
+
+// Minimal JSON reader over the raw text. Values that are not needed are
+// skipped in place, only keys are copied and only up to a short length.
+// Single quoted strings are accepted like the app's old regex fallback did.
+struct Scanner {
+  const char* p;
+  const char* end;
+
+  bool skipWhitespace() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+      p++;
+    return p < end;
+  }
+
+  bool consume(char c) {
+    if (!skipWhitespace() || *p != c)
+      return false;
+    p++;
+    return true;
+  }
+
+  bool peek(char c) {
+    return skipWhitespace() && *p == c;
+  }
+
+  // Copies at most size - 1 characters of the string into key
+  bool readString(char* key, size_t size) {
+    if (!skipWhitespace() || (*p != '"' && *p != '\''))
+      return false;
+    char quote = *p++;
+    size_t length = 0;
+    while (p < end && *p != quote) {
+      if (*p == '\\' && ++p == end)
+        return false;
+      if (key && length + 1 < size)
+        key[length++] = *p;
+      p++;
+    }
+    if (p == end)
+      return false;
+    p++;
+    if (key)
+      key[length] = '\0';
+    return true;
+  }
+
+  bool readNumber(double& value) {
+    if (!skipWhitespace())
+      return false;
+    char* numberEnd;
+    value = strtod(p, &numberEnd);
+    if (numberEnd == p)
+      return false;
+    p = numberEnd;
+    return true;
+  }
+
+  bool readBool(bool& value) {
+    if (!skipWhitespace())
+      return false;
+    if (end - p >= 4 && strncmp(p, "true", 4) == 0) {
+      value = true;
+      p += 4;
+      return true;
+    }
+    if (end - p >= 5 && strncmp(p, "false", 5) == 0) {
+      value = false;
+      p += 5;
+      return true;
+    }
+    return false;
+  }
+
+  bool skipValue() {
+    if (!skipWhitespace())
+      return false;
+    char c = *p;
+    if (c == '"' || c == '\'')
+      return readString(nullptr, 0);
+    if (c == '{' || c == '[') {
+      char close = (c == '{') ? '}' : ']';
+      p++;
+      if (consume(close))
+        return true;
+      do {
+        if (c == '{' && (!readString(nullptr, 0) || !consume(':')))
+          return false;
+        if (!skipValue())
+          return false;
+      } while (consume(','));
+      return consume(close);
+    }
+    // Numbers, true, false and null
+    const char* start = p;
+    while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+      p++;
+    return p > start;
+  }
+};
+
+
+// Reads [{"at": ms, "pos": 0 - 100}, ...], keeping what was read before an error
+bool readActionArray(Scanner& scanner, std::vector<Action>& actions) {
+  if (!scanner.consume('['))
+    return false;
+  if (scanner.consume(']'))
+    return true;
+  do {
+    if (!scanner.consume('{'))
+      return false;
+    double at = NAN;
+    double pos = NAN;
+    if (!scanner.peek('}')) {
+      do {
+        char key[8];
+        if (!scanner.readString(key, sizeof(key)) || !scanner.consume(':'))
+          return false;
+        bool read;
+        if (strcmp(key, "at") == 0)
+          read = scanner.readNumber(at);
+        else if (strcmp(key, "pos") == 0)
+          read = scanner.readNumber(pos);
+        else
+          read = scanner.skipValue();
+        if (!read)
+          return false;
+      } while (scanner.consume(','));
+    }
+    if (!scanner.consume('}'))
+      return false;
+    if (!std::isnan(at) && !std::isnan(pos))
+      actions.push_back({(int64_t)at, std::min(std::max((float)(pos / 100), 0.0f), 1.0f)});
+  } while (scanner.consume(','));
+  return scanner.consume(']');
+}
+
+
+const char* const ACTION_KEYS[] = {"actions", "Actions", "rawActions", "RawActions"};
+const int ACTION_KEY_COUNT = 4;
+
+// Top level object, the first non-empty actions key in ACTION_KEYS order wins
+bool readFunscriptObject(Scanner& scanner, std::vector<Action> (&found)[ACTION_KEY_COUNT], bool& inverted) {
+  if (!scanner.consume('{'))
+    return false;
+  if (scanner.consume('}'))
+    return true;
+  do {
+    char key[16];
+    if (!scanner.readString(key, sizeof(key)) || !scanner.consume(':'))
+      return false;
+    bool read = false;
+    bool handled = false;
+    for (int i = 0; i < ACTION_KEY_COUNT && !handled; i++) {
+      if (strcmp(key, ACTION_KEYS[i]) == 0 && scanner.peek('[')) {
+        found[i].clear();
+        read = readActionArray(scanner, found[i]);
+        handled = true;
+      }
+    }
+    if (!handled && strcmp(key, "inverted") == 0)
+      handled = read = scanner.readBool(inverted) || scanner.skipValue();
+    if (!handled)
+      read = scanner.skipValue();
+    if (!read)
+      return false;
+  } while (scanner.consume(','));
+  return scanner.consume('}');
+}
+
+
+// Fallback for files that are not valid JSON as a whole, reads the first
+// actions array found in the text on its own
+void findActionArray(const char* text, size_t length, std::vector<Action>& actions) {
+  const char* const patterns[] = {"\"actions\"", "\"Actions\"", "\"rawActions\"", "\"RawActions\""};
+  const char* end = text + length;
+  for (const char* pattern : patterns) {
+    size_t patternLength = strlen(pattern);
+    for (const char* p = text; p + patternLength <= end; p++) {
+      if (memcmp(p, pattern, patternLength) != 0)
+        continue;
+      Scanner scanner = {p + patternLength, end};
+      if (!scanner.consume(':'))
+        continue;
+      readActionArray(scanner, actions);
+      if (!actions.empty())
+        return;
+    }
+  }
+}
+
+
+// Godot's Tween easing equations over t in 0 - 1 with the result in 0 - 1.
+// OUT_IN is composed from OUT and IN as Godot does.
+double easeIn(double t, uint8_t trans) {
+  switch (trans) {
+    case TRANS_SINE:
+      return 1 - cos(t * M_PI / 2);
+    case TRANS_CIRC:
+      return 1 - sqrt(1 - t * t);
+    case TRANS_EXPO:
+      return (t == 0) ? 0 : pow(2, 10 * (t - 1)) - 0.001;
+    case TRANS_QUAD:
+      return t * t;
+    case TRANS_CUBIC:
+      return t * t * t;
+    case TRANS_QUART:
+      return t * t * t * t;
+    case TRANS_QUINT:
+      return t * t * t * t * t;
+    default:
+      return t;
+  }
+}
+
+double easeOut(double t, uint8_t trans) {
+  double u = t - 1;
+  switch (trans) {
+    case TRANS_SINE:
+      return sin(t * M_PI / 2);
+    case TRANS_CIRC:
+      return sqrt(1 - u * u);
+    case TRANS_EXPO:
+      return (t == 1) ? 1 : 1.001 * (1 - pow(2, -10 * t));
+    case TRANS_QUAD:
+      return -t * (t - 2);
+    case TRANS_CUBIC:
+      return u * u * u + 1;
+    case TRANS_QUART:
+      return 1 - u * u * u * u;
+    case TRANS_QUINT:
+      return u * u * u * u * u + 1;
+    default:
+      return t;
+  }
+}
+
+double easeInOut(double t, uint8_t trans) {
+  switch (trans) {
+    case TRANS_SINE:
+      return -(cos(M_PI * t) - 1) / 2;
+    case TRANS_EXPO:
+      if (t == 0 || t == 1)
+        return t;
+      t *= 2;
+      if (t < 1)
+        return pow(2, 10 * (t - 1)) / 2 - 0.0005;
+      return 1.0005 / 2 * (2 - pow(2, -10 * (t - 1)));
+    default:
+      // The power and circle curves are symmetric about the midpoint
+      if (t < 0.5)
+        return easeIn(t * 2, trans) / 2;
+      return 0.5 + easeOut(t * 2 - 1, trans) / 2;
+  }
+}
+
+double tween(double t, uint8_t trans, uint8_t ease) {
+  switch (ease) {
+    case EASE_IN:
+      return easeIn(t, trans);
+    case EASE_OUT:
+      return easeOut(t, trans);
+    case EASE_OUT_IN:
+      if (t < 0.5)
+        return easeOut(t * 2, trans) / 2;
+      return 0.5 + easeIn(t * 2 - 1, trans) / 2;
+    default:
+      return easeInOut(t, trans);
+  }
+}
+
+
+// Matches the firmware TRANS_BEZIER curve with end points fixed at 0 and 1
+double bezierCurve(double t, uint8_t control1, uint8_t control2) {
+  double p1 = (control1 - 64) / 128.0;
+  double p2 = (control2 - 64) / 128.0;
+  return ((((1 + 3 * p1 - 3 * p2) * t) + (3 * p2 - 6 * p1)) * t + 3 * p1) * t;
+}
+
+
+struct Fit {
+  double error;
+  uint8_t trans;
+  uint8_t ease;
+  uint8_t auxiliary;
+};
+
+const uint8_t EASES[] = {EASE_IN_OUT, EASE_IN, EASE_OUT, EASE_OUT_IN};
+
+// Curve that best joins action start to action end through the actions
+// between them, by largest depth error
+Fit bestFit(const std::vector<Action>& actions, size_t start, size_t end) {
+  double startTime = actions[start].at;
+  double duration = actions[end].at - startTime;
+  double from = actions[start].depth;
+  double delta = actions[end].depth - from;
+  Fit best = {INFINITY, TRANS_SINE, EASE_IN_OUT, 0};
+
+  for (uint8_t ease : EASES) {
+    for (uint8_t trans = TRANS_LINEAR; trans <= TRANS_QUINT; trans++) {
+      double error = 0;
+      for (size_t i = start + 1; i < end && error < best.error; i++) {
+        double t = (actions[i].at - startTime) / duration;
+        error = std::max(error, fabs(from + delta * tween(t, trans, ease) - actions[i].depth));
+      }
+      if (error < best.error)
+        best = {error, trans, ease, 0};
+    }
+  }
+
+  if (delta == 0 || end - start < 3)
+    return best;
+
+  // Least squares fit of the two Bezier control values with the end points
+  // pinned, y(t) = 3 * p1 * t * (1 - t)^2 + 3 * p2 * t^2 * (1 - t) + t^3
+  double s11 = 0, s12 = 0, s22 = 0, r1 = 0, r2 = 0;
+  for (size_t i = start + 1; i < end; i++) {
+    double t = (actions[i].at - startTime) / duration;
+    double b1 = 3 * t * (1 - t) * (1 - t);
+    double b2 = 3 * t * t * (1 - t);
+    double residual = (actions[i].depth - from) / delta - t * t * t;
+    s11 += b1 * b1;
+    s12 += b1 * b2;
+    s22 += b2 * b2;
+    r1 += b1 * residual;
+    r2 += b2 * residual;
+  }
+  double determinant = s11 * s22 - s12 * s12;
+  if (fabs(determinant) < 1e-9)
+    return best;
+  long control1 = lround(((r1 * s22 - r2 * s12) / determinant) * 128 + 64);
+  long control2 = lround(((r2 * s11 - r1 * s12) / determinant) * 128 + 64);
+  uint8_t p1 = (uint8_t)std::min(std::max(control1, 0L), 255L);
+  uint8_t p2 = (uint8_t)std::min(std::max(control2, 0L), 255L);
+  double error = 0;
+  for (size_t i = start + 1; i < end; i++) {
+    double t = (actions[i].at - startTime) / duration;
+    error = std::max(error, fabs(from + delta * bezierCurve(t, p1, p2) - actions[i].depth));
+  }
+  if (error < best.error)
+    best = {error, TRANS_BEZIER, p1, p2};
+  return best;
+}
+
+
+float sign(float value) {
+  return (value > 0) - (value < 0);
+}
+
+
+// Reads [depth, trans, ease, auxiliary], missing curve values default to
+// TRANS_SINE EASE_IN_OUT
+bool readMarker(Scanner& scanner, int64_t frame, std::vector<Marker>& markers) {
+  if (!scanner.consume('['))
+    return false;
+  double values[4] = {0, TRANS_SINE, EASE_IN_OUT, 0};
+  int count = 0;
+  if (!scanner.consume(']')) {
+    do {
+      double value;
+      if (!scanner.readNumber(value))
+        return false;
+      if (count < 4)
+        values[count++] = value;
+    } while (scanner.consume(','));
+    if (!scanner.consume(']'))
+      return false;
+  }
+  markers.push_back({frame, (float)values[0], (uint8_t)values[1], (uint8_t)values[2], (uint8_t)values[3]});
+  return true;
+}
+
+
+// {"<frame>": [...], ...}, other values are skipped
+bool readMarkerObject(Scanner& scanner, std::vector<Marker>& markers) {
+  if (!scanner.consume('{'))
+    return false;
+  if (scanner.consume('}'))
+    return true;
+  do {
+    char key[24];
+    if (!scanner.readString(key, sizeof(key)) || !scanner.consume(':'))
+      return false;
+    bool read = scanner.peek('[') ? readMarker(scanner, strtoll(key, nullptr, 10), markers) : scanner.skipValue();
+    if (!read)
+      return false;
+  } while (scanner.consume(','));
+  return scanner.consume('}');
+}
+
+
+bool readMeta(Scanner& scanner, MarkerFile& file) {
+  if (!scanner.consume('{'))
+    return false;
+  if (scanner.consume('}'))
+    return true;
+  do {
+    char key[24];
+    if (!scanner.readString(key, sizeof(key)) || !scanner.consume(':'))
+      return false;
+    bool read;
+    if (strcmp(key, "frame_rate") == 0)
+      read = scanner.readNumber(file.frameRate);
+    else if (strcmp(key, "video_offset_ms") == 0)
+      read = file.hasVideoOffset = scanner.readNumber(file.videoOffsetMs);
+    else
+      read = scanner.skipValue();
+    if (!read)
+      return false;
+  } while (scanner.consume(','));
+  return scanner.consume('}');
+}
+
+
+void putU16(uint8_t* packet, uint16_t value) {
+  packet[0] = value;
+  packet[1] = value >> 8;
+}
+
+void putU32(uint8_t* packet, uint32_t value) {
+  putU16(packet, value);
+  putU16(packet + 2, value >> 16);
+}
+
+}
+
+
+bool readActions(const char* text, size_t length, std::vector<Action>& actions) {
+  actions.clear();
+  std::vector<Action> found[ACTION_KEY_COUNT];
+  bool inverted = false;
+  Scanner scanner = {text, text + length};
+  if (readFunscriptObject(scanner, found, inverted)) {
+    for (auto& list : found) {
+      if (!list.empty()) {
+        actions.swap(list);
+        break;
+      }
+    }
+  } else {
+    inverted = false;
+    findActionArray(text, length, actions);
+  }
+  if (actions.empty())
+    return false;
+
+  if (inverted) {
+    for (Action& action : actions)
+      action.depth = 1 - action.depth;
+  }
+  std::stable_sort(actions.begin(), actions.end(), [](const Action& a, const Action& b) { return a.at < b.at; });
+  size_t merged = 0;
+  for (size_t i = 0; i < actions.size(); i++) {
+    if (merged > 0 && actions[merged - 1].at == actions[i].at)
+      actions[merged - 1] = actions[i];
+    else
+      actions[merged++] = actions[i];
+  }
+  actions.resize(merged);
+  return true;
+}
+
+
+std::vector<Segment> fit(const std::vector<Action>& actions, float tolerance) {
+  std::vector<Segment> segments;
+  if (actions.empty())
+    return segments;
+  segments.push_back({actions[0].at, actions[0].depth, TRANS_SINE, EASE_IN_OUT, 0});
+  size_t start = 0;
+  while (start + 1 < actions.size()) {
+    size_t end = start + 1;
+    Fit best = {0, TRANS_SINE, EASE_IN_OUT, 0};
+    float direction = sign(actions[end].depth - actions[start].depth);
+    while (end + 1 < actions.size() && end - start < (size_t)MAX_SPAN) {
+      float step = sign(actions[end + 1].depth - actions[end].depth);
+      if (step != 0 && direction != 0 && step != direction)
+        break;
+      if (actions[end + 1].at <= actions[start].at)
+        break;
+      Fit candidate = bestFit(actions, start, end + 1);
+      if (candidate.error > tolerance)
+        break;
+      if (direction == 0)
+        direction = step;
+      best = candidate;
+      end++;
+    }
+    segments.push_back({actions[end].at, actions[end].depth, best.trans, best.ease, best.auxiliary});
+    start = end;
+  }
+  return segments;
+}
+
+
+float interpolate(float from, float to, float t, uint8_t trans, uint8_t ease, uint8_t auxiliary) {
+  if (trans == TRANS_BEZIER)
+    return from + (to - from) * bezierCurve(t, ease, auxiliary);
+  return from + (to - from) * tween(t, trans, ease);
+}
+
+bool readMarkers(const char* text, size_t length, MarkerFile& file) {
+  file.markers.clear();
+  std::vector<Marker> topLevel;
+  bool hasMarkers = false;
+  Scanner scanner = {text, text + length};
+  if (!scanner.consume('{'))
+    return false;
+  if (!scanner.consume('}')) {
+    do {
+      char key[24];
+      if (!scanner.readString(key, sizeof(key)) || !scanner.consume(':'))
+        return false;
+      bool read;
+      if (strcmp(key, "meta") == 0 && scanner.peek('{')) {
+        read = readMeta(scanner, file);
+      } else if (strcmp(key, "markers") == 0 && scanner.peek('{')) {
+        read = readMarkerObject(scanner, file.markers);
+        hasMarkers = true;
+      } else if (scanner.peek('[')) {
+        read = readMarker(scanner, strtoll(key, nullptr, 10), topLevel);
+      } else {
+        read = scanner.skipValue();
+      }
+      if (!read)
+        return false;
+    } while (scanner.consume(','));
+    if (!scanner.consume('}'))
+      return false;
+  }
+  if (!hasMarkers)
+    file.markers.swap(topLevel);
+  return true;
+}
+
+
+void segmentMarkers(const std::vector<Segment>& segments, MarkerFile& file) {
+  file.markers.clear();
+  file.frameRate = 1000;
+  if (segments.empty())
+    return;
+  file.markers.reserve(segments.size() + 1);
+  auto rounded = [](float depth) { return roundf(depth * 10000) / 10000; };
+  file.markers.push_back({0, rounded(segments[0].depth), TRANS_SINE, EASE_IN_OUT, 0});
+  for (const Segment& segment : segments)
+    file.markers.push_back({segment.at, rounded(segment.depth), segment.trans, segment.ease, segment.auxiliary});
+}
+
+
+bool buildPath(MarkerFile& file, const PathOptions& options, Path& path) {
+  std::vector<Marker>& markers = file.markers;
+  std::stable_sort(markers.begin(), markers.end(), [](const Marker& a, const Marker& b) { return a.frame < b.frame; });
+  size_t count = 0;
+  for (size_t i = 0; i < markers.size(); i++) {
+    if (count > 0 && markers[count - 1].frame == markers[i].frame)
+      count--;
+    markers[count++] = markers[i];
+  }
+  markers.resize(count);
+  if (markers.size() < MIN_MARKERS)
+    return false;
+
+  path.packets.assign(markers.size() * MOVE_PACKET_SIZE, 0);
+  path.frames.assign(markers.size() - 1, 0);
+  path.depths.clear();
+  path.points.clear();
+  int64_t lastDisplayFrame = llround(markers.back().frame * options.ticksPerSecond / file.frameRate);
+  if (lastDisplayFrame > 0) {
+    path.depths.reserve(lastDisplayFrame);
+    path.points.reserve(lastDisplayFrame * 2);
+  }
+
+  float previousDepth = 0;
+  int64_t previousFrame = 0;
+  for (size_t i = 0; i < markers.size(); i++) {
+    const Marker& marker = markers[i];
+    uint8_t* packet = &path.packets[i * MOVE_PACKET_SIZE];
+    packet[0] = options.moveCommand;
+    putU32(packet + 1, (uint32_t)llround(marker.frame * 1000 / file.frameRate));
+    putU16(packet + 5, (uint16_t)lroundf(fabsf(options.motorDirection - marker.depth) * 10000));
+    packet[7] = marker.trans;
+    packet[8] = marker.ease;
+    packet[9] = marker.auxiliary;
+    // Only the preview is quantized to the physics tick rate, moves keep
+    // their exact timing and are scheduled by the device clock
+    int64_t displayFrame = llround(marker.frame * options.ticksPerSecond / file.frameRate);
+    if (i > 0) {
+      path.frames[i - 1] = (int32_t)previousFrame;
+      int64_t steps = displayFrame - previousFrame;
+      for (int64_t step = 0; step < steps; step++) {
+        float depth = interpolate(previousDepth, marker.depth, (float)step / steps, marker.trans, marker.ease, marker.auxiliary);
+        path.depths.push_back(depth);
+        path.points.push_back((previousFrame + step) * options.pathSpeed);
+        path.points.push_back(options.bottom + depth * (options.top - options.bottom));
+      }
+    }
+    previousDepth = marker.depth;
+    previousFrame = displayFrame;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,120 @@
+#ifndef FUNSCRIPT_H
+#define FUNSCRIPT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Funscript reading and curve fitting shared by the GDExtension and the
+// fit_funscript command line tool. Nothing here depends on Godot.
+//
+// Trans indices are the firmware TransType, ease values the Godot
+// Tween.EaseType the firmware EaseType matches. A fitted segment is a MOVE:
+// the device travels from the previous segment's depth to this one's over
+// the time between them following the curve.
+namespace funscript {
+
+const float DEFAULT_TOLERANCE = 0.02f;
+const int MAX_SPAN = 64;
+
+enum TransType : uint8_t {
+  TRANS_LINEAR,
+  TRANS_SINE,
+  TRANS_CIRC,
+  TRANS_EXPO,
+  TRANS_QUAD,
+  TRANS_CUBIC,
+  TRANS_QUART,
+  TRANS_QUINT,
+  TRANS_BEZIER
+};
+
+enum EaseType : uint8_t {
+  EASE_IN,
+  EASE_OUT,
+  EASE_IN_OUT,
+  EASE_OUT_IN
+};
+
+struct Action {
+  int64_t at;    // ms
+  float depth;   // 0 - 1
+};
+
+struct Segment {
+  int64_t at;
+  float depth;
+  uint8_t trans;
+  uint8_t ease;       // first Bezier control value for TRANS_BEZIER
+  uint8_t auxiliary;  // second Bezier control value for TRANS_BEZIER
+};
+
+// Reads the actions of a funscript in one pass without building a document,
+// sorted by time. Accepts the actions, Actions, rawActions and RawActions
+// keys and the inverted flag. Text that is not valid JSON as a whole is
+// searched for the actions array alone. Actions sharing a timestamp are
+// merged into the last of them. Returns false if there are none.
+bool readActions(const char* text, size_t length, std::vector<Action>& actions);
+
+// Fewest segments whose curve stays within tolerance of every action they
+// span, the first is the start point. Segments never span a change of
+// direction, so every extreme of the script is kept.
+std::vector<Segment> fit(const std::vector<Action>& actions, float tolerance);
+
+// Depth at weight t (0 - 1) of a move from one depth to another, matches the
+// path preview and the fit
+float interpolate(float from, float to, float t, uint8_t trans, uint8_t ease, uint8_t auxiliary);
+
+
+// A MOVE as stored in marker files, at a frame of the file's frame rate
+struct Marker {
+  int64_t frame;
+  float depth;
+  uint8_t trans;
+  uint8_t ease;
+  uint8_t auxiliary;
+};
+
+struct MarkerFile {
+  std::vector<Marker> markers;
+  double frameRate = 60;  // BounceX files use 60
+  bool hasVideoOffset = false;
+  double videoOffsetMs = 0;
+};
+
+// Reads {"meta": {"frame_rate", "video_offset_ms"}, "markers": {"<frame>":
+// [depth, trans, ease, auxiliary], ...}} or the markers object on its own,
+// in one pass. Returns false if the text is not a JSON object.
+bool readMarkers(const char* text, size_t length, MarkerFile& file);
+
+// Markers of fitted segments keyed by ms, starting with one at 0 like the
+// fit_funscript output
+void segmentMarkers(const std::vector<Segment>& segments, MarkerFile& file);
+
+struct PathOptions {
+  int ticksPerSecond;   // preview frames per second
+  float pathSpeed;      // preview pixels per frame
+  float motorDirection; // 0 normal, 1 reversed
+  float top;            // preview y at depth 1
+  float bottom;         // preview y at depth 0
+  uint8_t moveCommand;  // OSSM.Command.MOVE
+};
+
+struct Path {
+  std::vector<uint8_t> packets;  // 10 byte MOVE packets back to back
+  std::vector<int32_t> frames;   // frames[i] is where packet i + 1 starts
+  std::vector<float> depths;     // preview depth per frame
+  std::vector<float> points;     // preview line, x and y per frame
+};
+
+const size_t MOVE_PACKET_SIZE = 10;
+const size_t MIN_MARKERS = 6;
+
+// Sorts the markers, keeping the last of any with the same frame, and
+// builds the MOVE packets, seek index and preview in a single pass.
+// Returns false with fewer than MIN_MARKERS markers.
+bool buildPath(MarkerFile& file, const PathOptions& options, Path& path);
+
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include "funscript_loader.h"
+
+#include "funscript.h"
+
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_vector2_array.hpp>
+
+#include <cstring>
+
+using namespace godot;
+
+
+void FunscriptLoader::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("fit", "text", "tolerance"), &FunscriptLoader::fit);
+  ClassDB::bind_method(D_METHOD("build_path", "text", "is_funscript", "options"), &FunscriptLoader::build_path);
+}
+
+
+Array FunscriptLoader::fit(const PackedByteArray& text, float tolerance) {
+  Array result;
+  std::vector<funscript::Action> actions;
+  if (!funscript::readActions((const char*)text.ptr(), text.size(), actions))
+    return result;
+  std::vector<funscript::Segment> segments = funscript::fit(actions, tolerance);
+  result.resize(segments.size());
+  for (size_t i = 0; i < segments.size(); i++) {
+    const funscript::Segment& segment = segments[i];
+    Array entry;
+    entry.resize(5);
+    entry[0] = segment.at;
+    entry[1] = segment.depth;
+    entry[2] = segment.trans;
+    entry[3] = segment.ease;
+    entry[4] = segment.auxiliary;
+    result[i] = entry;
+  }
+  return result;
+}
+
+
+Dictionary FunscriptLoader::build_path(const PackedByteArray& text, bool is_funscript, const Dictionary& options) {
+  Dictionary result;
+  const char* data = (const char*)text.ptr();
+  funscript::MarkerFile file;
+  if (is_funscript) {
+    std::vector<funscript::Action> actions;
+    if (funscript::readActions(data, text.size(), actions)) {
+      float tolerance = options.get("tolerance", funscript::DEFAULT_TOLERANCE);
+      funscript::segmentMarkers(funscript::fit(actions, tolerance), file);
+    }
+  } else if (!funscript::readMarkers(data, text.size(), file)) {
+    result["error"] = "No JSON data found in file.";
+    return result;
+  }
+
+  funscript::PathOptions pathOptions;
+  pathOptions.ticksPerSecond = options.get("ticks_per_second", 60);
+  pathOptions.pathSpeed = options.get("path_speed", 30);
+  pathOptions.motorDirection = options.get("motor_direction", 0);
+  pathOptions.top = options.get("top", 0);
+  pathOptions.bottom = options.get("bottom", 0);
+  pathOptions.moveCommand = (int)options.get("move_command", 1);
+  funscript::Path path;
+  if (!funscript::buildPath(file, pathOptions, path)) {
+    result["error"] = "Insufficient path data in file.";
+    return result;
+  }
+
+  Array packets;
+  size_t packetCount = path.packets.size() / funscript::MOVE_PACKET_SIZE;
+  packets.resize(packetCount);
+  for (size_t i = 0; i < packetCount; i++) {
+    PackedByteArray packet;
+    packet.resize(funscript::MOVE_PACKET_SIZE);
+    memcpy(packet.ptrw(), &path.packets[i * funscript::MOVE_PACKET_SIZE], funscript::MOVE_PACKET_SIZE);
+    packets[i] = packet;
+  }
+
+  PackedInt32Array frames;
+  frames.resize(path.frames.size());
+  if (!path.frames.empty())
+    memcpy(frames.ptrw(), path.frames.data(), path.frames.size() * sizeof(int32_t));
+
+  PackedFloat32Array depths;
+  depths.resize(path.depths.size());
+  if (!path.depths.empty())
+    memcpy(depths.ptrw(), path.depths.data(), path.depths.size() * sizeof(float));
+
+  PackedVector2Array points;
+  points.resize(path.depths.size());
+  Vector2* point = points.ptrw();
+  for (size_t i = 0; i < path.depths.size(); i++)
+    point[i] = Vector2(path.points[i * 2], path.points[i * 2 + 1]);
+
+  result["packets"] = packets;
+  result["frames"] = frames;
+  result["path"] = depths;
+  result["points"] = points;
+  if (file.hasVideoOffset)
+    result["video_offset_ms"] = file.videoOffsetMs;
+  return result;
+}
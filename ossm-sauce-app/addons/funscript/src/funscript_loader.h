@@ -0,0 +1,39 @@
+#ifndef FUNSCRIPT_LOADER_H
+#define FUNSCRIPT_LOADER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+
+namespace godot {
+
+// Exposes the funscript fitter to the app. Instantiated through ClassDB so
+// the app falls back to the GDScript FunscriptFitter where the library is
+// not built.
+class FunscriptLoader : public RefCounted {
+  GDCLASS(FunscriptLoader, RefCounted)
+
+protected:
+  static void _bind_methods();
+
+public:
+  // Same result as FunscriptFitter.fit(FunscriptFitter.read_actions(text)),
+  // [[at_ms, depth, trans, ease, auxiliary], ...] or empty without actions
+  Array fit(const PackedByteArray& text, float tolerance);
+
+  // Parses a funscript (fitted at options.tolerance) or marker file and
+  // builds everything load_path needs in one pass:
+  //   packets          Array of MOVE PackedByteArrays
+  //   frames           PackedInt32Array seek index
+  //   path             PackedFloat32Array preview depth per frame
+  //   points           PackedVector2Array preview line
+  //   video_offset_ms  only when the marker file's meta has one
+  // or {"error": message}. options holds tolerance, ticks_per_second,
+  // path_speed, motor_direction, top, bottom and move_command.
+  Dictionary build_path(const PackedByteArray& text, bool is_funscript, const Dictionary& options);
+};
+
+}
+
+#endif
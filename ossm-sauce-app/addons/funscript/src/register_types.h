@@ -0,0 +1,11 @@
+#ifndef FUNSCRIPT_REGISTER_TYPES_H
+#define FUNSCRIPT_REGISTER_TYPES_H
+
+#include <godot_cpp/core/class_db.hpp>
+
+using namespace godot;
+
+void initialize_funscript_module(ModuleInitializationLevel p_level);
+void uninitialize_funscript_module(ModuleInitializationLevel p_level);
+
+#endif
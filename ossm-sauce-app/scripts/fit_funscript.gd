@@ -0,0 +1,44 @@
+extends SceneTree
+
+# Command line front end for FunscriptFitter, writes a marker file keyed by
+# milliseconds that the app loads like any other path:
+#   godot --headless --script res://scripts/fit_funscript.gd -- <in.funscript> <out.json> [tolerance]
+
+
+func _init():
+	var args := OS.get_cmdline_user_args()
+	if args.size() < 2:
+		printerr("Usage: fit_funscript.gd -- <in.funscript> <out.json> [tolerance]")
+		quit(1)
+		return
+	var tolerance := FunscriptFitter.DEFAULT_TOLERANCE
+	if args.size() > 2:
+		tolerance = args[2].to_float()
+
+	var file = FileAccess.open(args[0], FileAccess.READ)
+	if not file:
+		printerr("Error: Failed to read ", args[0])
+		quit(1)
+		return
+	var actions := FunscriptFitter.read_actions(file.get_as_text())
+	file.close()
+	if actions.is_empty():
+		quit(1)
+		return
+
+	var segments := FunscriptFitter.fit(actions, tolerance)
+	var markers: Dictionary
+	markers[0] = [actions[0][1], 1, 2, 0]
+	for segment in segments:
+		markers[segment[0]] = [snappedf(segment[1], 0.0001), segment[2], segment[3], segment[4]]
+
+	var output = FileAccess.open(args[1], FileAccess.WRITE)
+	if not output:
+		printerr("Error: Failed to write ", args[1])
+		quit(1)
+		return
+	output.store_string(JSON.stringify({"meta": {"frame_rate": 1000}, "markers": markers}))
+	output.close()
+	print("%d actions fitted to %d segments at tolerance %.3f" % [
+			actions.size(), segments.size() - 1, tolerance])
+	quit()
@@ -0,0 +1,82 @@
+class_name FlightRecorder
+extends RefCounted
+
+# Collects a device flight recorder dump (RECORDER_DUMP frames) and replays
+# recorded command streams with their original timing.
+
+const HEADER_SIZE: int = 5
+const ENTRY_SIZE: int = 40
+const DATA_SIZE: int = 24
+const RECORDINGS_DIR: String = "user://recordings"
+
+var entries: Array
+var total: int = -1
+
+
+# Adds one dump frame, returns true once every entry has arrived
+func add_frame(frame: PackedByteArray) -> bool:
+	if frame.size() < HEADER_SIZE:
+		return false
+	var first_index: int = frame.decode_u16(1)
+	if first_index == 0:
+		entries.clear()
+	total = frame.decode_u16(3)
+	for offset in range(HEADER_SIZE, frame.size() - ENTRY_SIZE + 1, ENTRY_SIZE):
+		var length: int = frame.decode_u16(offset + 12)
+		entries.append({
+			"arrival_us": frame.decode_u32(offset),
+			"play_time_ms": frame.decode_u32(offset + 4),
+			"position": frame.decode_s32(offset + 8),
+			"length": length,
+			"mode": frame[offset + 14],
+			"queued_moves": frame[offset + 15],
+			"data": frame.slice(offset + 16, offset + 16 + mini(length, DATA_SIZE)).hex_encode(),
+		})
+	return entries.size() >= total
+
+
+# Writes the collected dump as JSON and returns its path, or "" on failure
+func save() -> String:
+	DirAccess.make_dir_recursive_absolute(RECORDINGS_DIR)
+	var time := Time.get_datetime_string_from_system().replace(":", "-")
+	var path := RECORDINGS_DIR + "/flight_" + time + ".json"
+	var file = FileAccess.open(path, FileAccess.WRITE)
+	if not file:
+		printerr("Error: Failed to write ", path)
+		return ""
+	file.store_string(JSON.stringify({"entries": entries}, "\t"))
+	file.close()
+	return path
+
+
+static func load_entries(path: String) -> Array:
+	var file = FileAccess.open(path, FileAccess.READ)
+	if not file:
+		printerr("Error: Failed to read ", path)
+		return []
+	var data = JSON.parse_string(file.get_as_text())
+	file.close()
+	if not data is Dictionary or not data.get("entries") is Array:
+		printerr("Error: No recording data in ", path)
+		return []
+	return data.entries
+
+
+# Returns [[delay_seconds, packet], ...] for every entry that was recorded
+# in full, RECORDER_DUMP requests themselves are left out
+static func replay_schedule(recorded: Array, speed: float) -> Array:
+	var schedule: Array
+	var previous_us := -1
+	for entry in recorded:
+		var packet: PackedByteArray = String(entry.data).hex_decode()
+		if int(entry.length) > DATA_SIZE or packet.is_empty():
+			continue
+		if packet[0] == OSSM.Command.RECORDER_DUMP:
+			continue
+		var arrival_us: int = int(entry.arrival_us)
+		var delay := 0.0
+		if previous_us >= 0:
+			delay = ((arrival_us - previous_us) & 0xFFFFFFFF) / 1000000.0 / speed
+		previous_us = arrival_us
+		schedule.append([delay, packet])
+	return schedule
@@ -0,0 +1,196 @@
+class_name FunscriptFitter
+extends RefCounted
+
+# Fits funscript actions to the fewest MOVE segments whose firmware curve
+# stays within a position tolerance of every action it spans. Segments never
+# span a change of direction, so every extreme of the script is kept.
+# Fallback for platforms without the native FunscriptLoader in
+# addons/funscript, which implements the same fit.
+
+const DEFAULT_TOLERANCE: float = 0.02
+const MAX_SPAN: int = 64
+
+# Same as OSSM.TRANS_BEZIER, autoloads are not loaded for the command line tool
+const TRANS_BEZIER: int = 8
+
+# Firmware TransType index → Godot Tween.TransitionType
+const TWEEN_TRANS: Array = [
+	Tween.TRANS_LINEAR,
+	Tween.TRANS_SINE,
+	Tween.TRANS_CIRC,
+	Tween.TRANS_EXPO,
+	Tween.TRANS_QUAD,
+	Tween.TRANS_CUBIC,
+	Tween.TRANS_QUART,
+	Tween.TRANS_QUINT,
+]
+
+const EASES: Array = [
+	Tween.EASE_IN_OUT,
+	Tween.EASE_IN,
+	Tween.EASE_OUT,
+	Tween.EASE_OUT_IN,
+]
+
+
+# Returns [[at_ms, depth], ...] sorted by time with depth in 0 - 1,
+# or an empty array if the text holds no actions.
+static func read_actions(file_text: String) -> Array:
+	var parsed_funscript = JSON.parse_string(file_text)
+	var actions_list = null
+	var inverted := false
+	if parsed_funscript is Dictionary:
+		if parsed_funscript.get("inverted", false):
+			inverted = true
+		for key in ["actions", "Actions", "rawActions", "RawActions"]:
+			if parsed_funscript.get(key) is Array and not parsed_funscript[key].is_empty():
+				actions_list = parsed_funscript[key]
+				break
+	if actions_list == null:
+		actions_list = extract_actions(file_text)
+	if actions_list == null:
+		return []
+
+	var actions: Array
+	actions.resize(actions_list.size())
+	var index := 0
+	for action in actions_list:
+		var depth: float = clamp(action.pos / 100, 0, 1)
+		if inverted:
+			depth = 1.0 - depth
+		actions[index] = [int(action.at), depth]
+		index += 1
+	actions.sort_custom(func(a, b): return a[0] < b[0])
+	# Actions sharing a timestamp are merged into one
+	var merged: Array
+	for action in actions:
+		if not merged.is_empty() and merged[-1][0] == action[0]:
+			merged[-1] = action
+		else:
+			merged.append(action)
+	return merged
+
+
+# Fallback for files that are not valid JSON as a whole, cuts the actions
+# array out of the text and parses it on its own
+static func extract_actions(file_text: String):
+	file_text = file_text.replace("\n", "")
+	var actions_pattern = RegEx.new()
+	actions_pattern.compile('"[Aa]ctions":\\s*\\[.*?\\]')
+	var actions_regex = actions_pattern.search(file_text)
+	if not actions_regex:
+		actions_pattern.compile('"[Rr]aw[Aa]ctions":\\s*\\[.*?\\]')
+		actions_regex = actions_pattern.search(file_text)
+	if not actions_regex:
+		printerr("No actions data found in the funscript")
+		return null
+
+	var actions_text = actions_regex.get_string(0)
+	actions_text = actions_text.replace("'", '"')
+	actions_text = actions_text.insert(0, "{")
+	actions_text = actions_text.insert(actions_text.length(), "}")
+	var actions_data = JSON.parse_string(actions_text)
+	if not actions_data:
+		printerr("Failed to parse funscript JSON")
+		return null
+	return actions_data[actions_data.keys()[0]]
+
+
+# Returns [[at_ms, depth, trans, ease, auxiliary], ...] where the first entry
+# is the start point. A tolerance of 0 only merges actions the curve hits exactly.
+static func fit(actions: Array, tolerance: float) -> Array:
+	var segments: Array
+	if actions.is_empty():
+		return segments
+	segments.append([actions[0][0], actions[0][1], 1, Tween.EASE_IN_OUT, 0])
+	var start := 0
+	while start < actions.size() - 1:
+		var end := start + 1
+		var best := [0.0, 1, Tween.EASE_IN_OUT, 0]
+		var direction: float = signf(actions[end][1] - actions[start][1])
+		while end + 1 < actions.size() and end - start < MAX_SPAN:
+			var step: float = signf(actions[end + 1][1] - actions[end][1])
+			if step != 0 and direction != 0 and step != direction:
+				break
+			if actions[end + 1][0] <= actions[start][0]:
+				break
+			var candidate := best_fit(actions, start, end + 1)
+			if candidate[0] > tolerance:
+				break
+			if direction == 0:
+				direction = step
+			best = candidate
+			end += 1
+		segments.append([actions[end][0], actions[end][1], best[1], best[2], best[3]])
+		start = end
+	return segments
+
+
+# Returns [max_error, trans, ease, auxiliary] for the curve that best joins
+# action start to action end through the actions between them.
+static func best_fit(actions: Array, start: int, end: int) -> Array:
+	var start_time: float = actions[start][0]
+	var duration: float = actions[end][0] - start_time
+	var from: float = actions[start][1]
+	var delta: float = actions[end][1] - from
+	var best := [INF, 1, Tween.EASE_IN_OUT, 0]
+
+	for ease in EASES:
+		for trans in TWEEN_TRANS.size():
+			var error := 0.0
+			for i in range(start + 1, end):
+				var t: float = (actions[i][0] - start_time) / duration
+				var curve: float = Tween.interpolate_value(0.0, 1.0, t, 1.0, TWEEN_TRANS[trans], ease)
+				error = max(error, abs(from + delta * curve - actions[i][1]))
+				if error >= best[0]:
+					break
+			if error < best[0]:
+				best = [error, trans, ease, 0]
+
+	if delta == 0 or end - start < 3:
+		return best
+
+	# Least squares fit of the two Bezier control values with the end points
+	# pinned, y(t) = 3 * p1 * t * (1 - t)^2 + 3 * p2 * t^2 * (1 - t) + t^3
+	var s11 := 0.0
+	var s12 := 0.0
+	var s22 := 0.0
+	var r1 := 0.0
+	var r2 := 0.0
+	for i in range(start + 1, end):
+		var t: float = (actions[i][0] - start_time) / duration
+		var b1 := 3 * t * (1 - t) * (1 - t)
+		var b2 := 3 * t * t * (1 - t)
+		var residual: float = (actions[i][1] - from) / delta - t * t * t
+		s11 += b1 * b1
+		s12 += b1 * b2
+		s22 += b2 * b2
+		r1 += b1 * residual
+		r2 += b2 * residual
+	var determinant := s11 * s22 - s12 * s12
+	if abs(determinant) < 1e-9:
+		return best
+	var control_1 := clampi(roundi(((r1 * s22 - r2 * s12) / determinant) * 128 + 64), 0, 255)
+	var control_2 := clampi(roundi(((r2 * s11 - r1 * s12) / determinant) * 128 + 64), 0, 255)
+	var error := 0.0
+	for i in range(start + 1, end):
+		var t: float = (actions[i][0] - start_time) / duration
+		var curve := bezier_curve(t, control_1, control_2)
+		error = max(error, abs(from + delta * curve - actions[i][1]))
+	if error < best[0]:
+		best = [error, TRANS_BEZIER, control_1, control_2]
+	return best
+
+
+# Matches the firmware TRANS_BEZIER curve with end points fixed at 0 and 1
+static func bezier_curve(t: float, control_1: int, control_2: int) -> float:
+	var p1 := (control_1 - 64) / 128.0
+	var p2 := (control_2 - 64) / 128.0
+	return ((((1 + 3 * p1 - 3 * p2) * t) + (3 * p2 - 6 * p1)) * t + 3 * p1) * t
+
+
+# Depth of a fitted marker curve at weight t, used by the path preview
+static func interpolate(from: float, to: float, t: float, trans: int, ease: int, auxiliary: int) -> float:
+	if trans == TRANS_BEZIER:
+		return from + (to - from) * bezier_curve(t, ease, auxiliary)
+	return Tween.interpolate_value(from, to - from, t, 1.0, TWEEN_TRANS[trans], ease)
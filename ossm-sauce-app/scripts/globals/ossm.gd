@@ -17,4 +17,49 @@ enum Command {
   SET_HOMING_SPEED,
   SET_HOMING_TRIGGER,
   SMOOTH_MOVE,
+  VIBRATE_TABLE,
+  CALIBRATE_VIBRATION,
+  OVERLAY,
+  PATTERN_UPLOAD,
+  PATTERN_CONTROL,
+  SEEK,
+  RECORDER_DUMP,
+  TCODE,
+  SERIAL_MODE,
+  UDP_CHANNEL,
+  CLOCK_SYNC,
+  SCHEDULE,
+  RECALIBRATE,
+  AUTOTUNE,
+  ESTOP,
+}
+
+# Stroke transition past Tween.TRANS_QUINT, ease and auxiliary are the two
+# Bezier control values where 64 maps to 0 and 192 maps to 1
+const TRANS_BEZIER = 8
+
+enum Waveform {
+  SQUARE,
+  SINE,
+  TRIANGLE,
+  TABLE,
+}
+
+# RECALIBRATE response value, sent on every stage change
+enum Recalibrate {
+  IDLE,
+  SETTLE,
+  SEEK_MAX,
+  SEEK_MIN,
+  DONE,
+  FAILED,
+}
+
+# AUTOTUNE response value, sent on every stage change
+enum AutoTune {
+  IDLE,
+  ACCELERATION,
+  SPEED,
+  DONE,
+  FAILED,
 }
@@ -85,6 +85,10 @@ func handle_http_request(client: StreamPeerTCP):
 			handle_disconnect(client, body)
 		"/status":
 			handle_status(client)
+		"/recorder_dump":
+			handle_recorder_dump(client)
+		"/recorder_replay":
+			handle_recorder_replay(client, body)
 		_:
 			send_http_response(client, 404, "Not Found")
 
@@ -129,6 +133,31 @@ func handle_disconnect(client: StreamPeerTCP, _body: String):
 	send_http_response(client, 200, '{"status": "disconnected"}')
 
 
+func handle_recorder_dump(client: StreamPeerTCP):
+	command_received.emit({"action": "recorder_dump"})
+	send_http_response(client, 200, '{"status": "requested"}')
+
+
+func handle_recorder_replay(client: StreamPeerTCP, body: String):
+	var json = JSON.new()
+	var parse_result = json.parse(body)
+	
+	if parse_result != OK:
+		send_http_response(client, 400, "Invalid JSON")
+		return
+	
+	var data = json.data
+	if not data.has("file"):
+		send_http_response(client, 400, "Missing file field")
+		return
+	
+	command_received.emit({
+		"action": "recorder_replay",
+		"file": data.file,
+		"speed": float(data.get("speed", 1.0))})
+	send_http_response(client, 200, '{"status": "replaying", "file": "' + data.file + '"}')
+
+
 func handle_status(client: StreamPeerTCP):
 	var bridge = get_node_or_null("../MCPBridge") # Adjust path as needed
 	var status = {
@@ -23,6 +23,14 @@ var ticks_per_second: int
 
 var path_speed: int = 30
 
+# Max position error when merging funscript actions into curve segments
+var fit_tolerance: float = FunscriptFitter.DEFAULT_TOLERANCE
+
+# Native fitter from addons/funscript, null where the library is not built
+# for the platform and the GDScript FunscriptFitter is used instead
+var funscript_loader = ClassDB.instantiate("FunscriptLoader") if ClassDB.class_exists("FunscriptLoader") else null
+const FIT_CACHE_DIR = "user://fitted"
+
 var paused := true
 var _seek_dragging := false
 
@@ -37,6 +45,13 @@ var buffer_sent: int
 var play_offset_ms: int
 var _seeking: bool
 
+# Move queue credits per device client_id, refreshed by every response.
+# MOVE packets are broadcast, so one is sent only when every device has room.
+const DEFAULT_MOVE_SLOTS = 6
+var moves_sent: Dictionary
+var device_moves_received: Dictionary
+var device_move_slots: Dictionary
+
 var max_speed: int
 var max_acceleration: int
 var motor_direction: int = 0
@@ -45,6 +60,10 @@ var min_stroke_duration: float
 var max_stroke_duration: float
 
 signal homing_complete
+signal seek_complete(next_marker_index: int)
+
+# SEEK replies by client_id, null until that device answered
+var seek_replies: Dictionary
 
 @onready var PATH_TOP = $PathDisplay/PathArea.position.y
 @onready var PATH_BOTTOM = PATH_TOP + $PathDisplay/PathArea.size.y
@@ -120,25 +139,8 @@ func _physics_process(delta) -> void:
 			$CircleSelection.show_restart()
 		return
 	
-	var frames = marker_frames[active_path_index]
-	var active_path = network_paths[active_path_index]
-	var current_marker = marker_index - buffer_sent
-	if current_marker < frames.size() and frame == frames[current_marker]:
-		if %WebSocket.server_started:
-			if marker_index < active_path.size():
-				%WebSocket.server.broadcast_binary(active_path[marker_index])
-			elif active_path_index < network_paths.size() - 1:
-				var overreach_index = marker_index - active_path.size()
-				var next_path = network_paths[active_path_index + 1]
-				if overreach_index < next_path.size():
-					%WebSocket.server.broadcast_binary(next_path[overreach_index])
-			elif $Menu.loop_playlist:
-				var overreach_index = marker_index - active_path.size()
-				var next_path = network_paths[0]
-				if overreach_index < next_path.size():
-					%WebSocket.server.broadcast_binary(next_path[overreach_index])
-		if current_marker < frames.size() - 1:
-			marker_index += 1
+	if %WebSocket.server_started:
+		fill_move_buffer(true)
 	
 	var depth: float = paths[active_path_index][frame]
 	$PathDisplay/Paths.get_child(active_path_index).position.x -= path_speed
@@ -151,46 +153,109 @@ func _physics_process(delta) -> void:
 
 func transition_to_path(next_index: int):
 	var overreach_sent = maxi(marker_index - network_paths[active_path_index].size(), 0)
-	var next_path = network_paths[next_index]
 	active_path_index = next_index
 	display_active_path_index(false, false)
 	# Top up buffer if overreach didn't cover it
 	marker_index = overreach_sent
 	buffer_sent = overreach_sent
-	while buffer_sent < 6 and marker_index < next_path.size():
-		%WebSocket.server.broadcast_binary(next_path[marker_index])
-		marker_index += 1
-		buffer_sent += 1
+	fill_move_buffer(true)
 	var path_list = $Menu/Playlist/Scroll/VBox
 	$Menu/Playlist._on_item_selected(path_list.get_child(next_index))
 	path_list.get_child(next_index).set_active()
 
 
-func send_command(value: int):
+# RESET carries the path index of the first MOVE sent after it, so the
+# device can answer SEEK in path indexes when playback restarts part way
+func send_command(value: int, path_index := 0):
 	if %WebSocket.ossm_connected:
 		var command:PackedByteArray
 		command.resize(1)
 		command[0] = value
-		%WebSocket.server.broadcast_binary(command)
+		if value == OSSM.Command.RESET:
+			command.resize(5)
+			command.encode_u32(1, path_index)
+		if value == OSSM.Command.PAUSE:
+			%WebSocket.send_synchronized(command)
+		else:
+			%WebSocket.server.broadcast_binary(command)
+		if value == OSSM.Command.RESET:
+			for client_id in moves_sent:
+				moves_sent[client_id] = 0
+				device_moves_received[client_id] = 0
+
+
+# Starts counting a device's credits from its CONNECTION response
+func add_move_client(client_id: int, moves_received: int):
+	moves_sent[client_id] = moves_received
+	device_moves_received[client_id] = moves_received
+	device_move_slots[client_id] = DEFAULT_MOVE_SLOTS
+
+
+func remove_move_client(client_id: int):
+	moves_sent.erase(client_id)
+	device_moves_received.erase(client_id)
+	device_move_slots.erase(client_id)
+	if seek_replies.erase(client_id):
+		check_seek_complete()
+
+
+# Device reports free move queue slots and MOVE packets received so far.
+# Packets sent but not yet received are still in flight and hold a credit.
+func update_move_credits(client_id: int, free_slots: int, moves_received: int):
+	if not moves_sent.has(client_id):
+		return # Not connected yet, counted from its CONNECTION response
+	if (moves_sent[client_id] - moves_received) & 0xFFFF > 0xFF:
+		return # Stale report from before the last RESET
+	device_move_slots[client_id] = free_slots
+	device_moves_received[client_id] = moves_received
+	if not paused and AppMode.active == AppMode.MOVE:
+		fill_move_buffer(true)
+
+
+# Credits of the device with the least room, 0 with none connected
+func move_credits() -> int:
+	var credits: Array
+	for client_id in moves_sent:
+		var in_flight: int = (moves_sent[client_id] - device_moves_received[client_id]) & 0xFFFF
+		credits.append(device_move_slots[client_id] - in_flight)
+	return credits.min() if not credits.is_empty() else 0
+
+
+func next_move_packet(overreach: bool):
+	var active_path = network_paths[active_path_index]
+	if marker_index < active_path.size():
+		return active_path[marker_index]
+	if not overreach:
+		return null
+	var next_path: Array
+	if active_path_index < network_paths.size() - 1:
+		next_path = network_paths[active_path_index + 1]
+	elif $Menu.loop_playlist:
+		next_path = network_paths[0]
+	var overreach_index = marker_index - active_path.size()
+	if overreach_index < next_path.size():
+		return next_path[overreach_index]
+	return null
+
+
+# Send queued moves until the device's move queue is full
+func fill_move_buffer(overreach := false):
+	if not %WebSocket.ossm_connected or active_path_index == null:
+		return
+	while move_credits() > 0:
+		var packet = next_move_packet(overreach)
+		if packet == null:
+			break
+		%WebSocket.server.broadcast_binary(packet)
+		for client_id in moves_sent:
+			moves_sent[client_id] = (moves_sent[client_id] + 1) & 0xFFFF
+		marker_index += 1
+		buffer_sent += 1
 
 
 func home_to(target_position: int):
 	if %WebSocket.ossm_connected:
-		%CircleSelection.show_hourglass()
-		%ActionPanel.disable_buttons(true)
-		var displays = [
-			%PathDisplay,
-			%PositionControls,
-			%LoopControls,
-			%VibrationControls,
-			%BridgeControls,
-			%ActionPanel,
-			%VideoPlayer,
-			%Settings,
-			%AddFile,
-			%Menu]
-		for display in displays:
-			display.modulate.a = 0.05
+		show_homing()
 		var command: PackedByteArray
 		command.resize(5)
 		command.encode_u8(0, OSSM.Command.HOMING)
@@ -198,15 +263,70 @@ func home_to(target_position: int):
 		%WebSocket.server.broadcast_binary(command)
 
 
+func show_homing():
+	%CircleSelection.show_hourglass()
+	%ActionPanel.disable_buttons(true)
+	var displays = [
+		%PathDisplay,
+		%PositionControls,
+		%LoopControls,
+		%VibrationControls,
+		%BridgeControls,
+		%ActionPanel,
+		%VideoPlayer,
+		%Settings,
+		%AddFile,
+		%Menu]
+	for display in displays:
+		display.modulate.a = 0.05
+
+
+func hide_homing():
+	%CircleSelection.hide()
+	%CircleSelection.homing_lock = false
+	%ActionPanel.disable_buttons(false)
+	var displays = [
+		%PathDisplay,
+		%PositionControls,
+		%LoopControls,
+		%VibrationControls,
+		%BridgeControls,
+		%ActionPanel,
+		%VideoPlayer,
+		%Settings,
+		%AddFile,
+		%Menu]
+	for display in displays:
+		display.modulate.a = 1
+
+
+# The device recalibrates on its own after a stall. Playback holds until it
+# is done, then pauses to resync with the device at the current frame.
+func recalibration_progress(stage: int):
+	match stage:
+		OSSM.Recalibrate.SETTLE, OSSM.Recalibrate.SEEK_MAX, OSSM.Recalibrate.SEEK_MIN:
+			paused = true
+			show_homing()
+		OSSM.Recalibrate.DONE, OSSM.Recalibrate.FAILED:
+			if stage == OSSM.Recalibrate.FAILED:
+				printerr("Recalibration failed, range limits unchanged")
+			hide_homing()
+			%ActionPanel._on_pause_button_pressed()
+
+
 func play():
 	var command: PackedByteArray
+	# Devices in a group start later, at the point the app has reached by then
+	var lead_ms: int = %WebSocket.group_lead_ms()
+	var start_ms := play_offset_ms
 	if AppMode.active == AppMode.MOVE and active_path_index != null:
 		paused = false
 		play_offset_ms = int(frame * 1000.0 / ticks_per_second)
+		start_ms = play_offset_ms + lead_ms
 	command.resize(6)
 	command.encode_u8(0, OSSM.Command.PLAY)
 	command.encode_u8(1, AppMode.active)
-	command.encode_u32(2, play_offset_ms)
+	command.encode_u32(2, start_ms)
 	if %WebSocket.ossm_connected:
 		if AppMode.active == AppMode.MOVE:
 			var safe_accel: PackedByteArray
@@ -214,7 +334,7 @@ func play():
 			safe_accel.encode_u8(0, OSSM.Command.SET_GLOBAL_ACCELERATION)
 			safe_accel.encode_u32(1, 60000)
 			%WebSocket.server.broadcast_binary(safe_accel)
-		%WebSocket.server.broadcast_binary(command)
+		%WebSocket.send_synchronized(command, lead_ms)
 		# Restore user's acceleration after a comfortable ramp-up
 		$PathDisplay/AccelTimer.start(0.8)
 
@@ -227,36 +347,31 @@ func pause():
 	
 	if active_path_index == null:
 		return
+	# Let a scheduled PAUSE land before the commands that follow it
+	var lead_ms: int = %WebSocket.group_lead_ms()
+	if lead_ms > 0:
+		await get_tree().create_timer(lead_ms / 1000.0).timeout
+		if not %WebSocket.ossm_connected:
+			return
 	if AppMode.active != AppMode.MOVE or paths[active_path_index].is_empty():
 		return
 	
+	# Find cascade and buffer start for current frame
+	var buffer_start := marker_frames[active_path_index].bsearch(frame, false)
+	var cascade_index := maxi(buffer_start - 1, 0)
+	
 	# Sync OSSM to current path position
 	var current_depth: float = paths[active_path_index][frame]
-	send_command(OSSM.Command.RESET)
+	send_command(OSSM.Command.RESET, cascade_index)
 	home_to(round(current_depth * 10000))
 	await homing_complete
 	if not %WebSocket.ossm_connected:
 		return
 	
-	# Find cascade and buffer start for current frame
-	var frames = marker_frames[active_path_index]
-	var buffer_start := 0
-	var cascade_index := 0
-	for i in frames.size():
-		if frames[i] <= frame:
-			cascade_index = i
-			buffer_start = i + 1
-		else:
-			break
-	
 	# Send cascade packet + buffer
-	%WebSocket.server.broadcast_binary(network_paths[active_path_index][cascade_index])
-	marker_index = buffer_start
-	buffer_sent = 0
-	while buffer_sent < 6 and marker_index < network_paths[active_path_index].size():
-		%WebSocket.server.broadcast_binary(network_paths[active_path_index][marker_index])
-		marker_index += 1
-		buffer_sent += 1
+	marker_index = cascade_index
+	fill_move_buffer()
+	buffer_sent = marker_index - buffer_start
 	
 	# Reduce acceleration and nudge in both directions to force direction change
 	var safe_accel: PackedByteArray
@@ -340,6 +455,8 @@ func apply_user_settings():
 		$Settings/VBox/Network/Port/Input.value = port_number
 		%WebSocket.port = port_number
 	
+	%WebSocket.udp_port = user_settings.get_value('network', 'udp_port', 0)
+	
 	if user_settings.has_section_key('device_settings', 'motor_direction'):
 		var value = user_settings.get_value('device_settings', 'motor_direction', 0)
 		$Settings/VBox/ReverseMotorDirection.button_pressed = bool(value)
@@ -432,6 +549,11 @@ func apply_user_settings():
 		%VideoPlayer/Main/PlayerSelection.select(vp_type)
 		%VideoPlayer._on_player_selection_item_selected(vp_type)
 	
+	fit_tolerance = user_settings.get_value(
+			'app_settings',
+			'fit_tolerance',
+			FunscriptFitter.DEFAULT_TOLERANCE)
+	
 	if user_settings.has_section_key('app_settings', 'mode'):
 		$Menu.select_mode(user_settings.get_value('app_settings', 'mode'))
 	else:
@@ -505,112 +627,140 @@ func load_path(file_name: String) -> bool:
 	if not file:
 		printerr("Error: Failed to read file.")
 		return false
-	var file_text := file.get_as_text()
+	var file_bytes := file.get_buffer(file.get_length())
 	file.close()
 	
+	var is_funscript := file_name.ends_with(".funscript")
+	var built: Dictionary
+	if funscript_loader:
+		built = funscript_loader.build_path(file_bytes, is_funscript, {
+				"tolerance": fit_tolerance,
+				"ticks_per_second": ticks_per_second,
+				"path_speed": path_speed,
+				"motor_direction": motor_direction,
+				"top": PATH_TOP,
+				"bottom": PATH_BOTTOM,
+				"move_command": OSSM.Command.MOVE})
+	else:
+		built = build_path(file_bytes.get_string_from_utf8(), is_funscript)
+	if built.has("error"):
+		printerr("Error: " + built["error"])
+		return false
+	if built.has("video_offset_ms"):
+		%VideoPlayer/Main/VideoOffset/Input.value = built["video_offset_ms"]
+	
+	network_paths.append(built["packets"])
+	var path_line := Line2D.new()
+	path_line.width = 15
+	path_line.points = built["points"]
+	path_line.hide()
+	paths.append(built["path"])
+	marker_frames.append(built["frames"])
+	$PathDisplay/Paths.add_child(path_line)
+	return true
+
+
+# GDScript version of FunscriptLoader.build_path for platforms without the
+# native library
+func build_path(file_text: String, is_funscript: bool) -> Dictionary:
+	var built: Dictionary
 	var file_data: Dictionary
+	# Marker keys count frames at this rate, BounceX files use 60
+	var frame_rate: float = 60
 	
-	if file_name.ends_with(".funscript"):
-		file_text = file_text.replace("\n", "")
-		var parsed_funscript = JSON.parse_string(file_text)
-		var inverted := false
-		if parsed_funscript is Dictionary and parsed_funscript.get("inverted", false):
-			inverted = true
-	
-		var actions_pattern = RegEx.new()
-		actions_pattern.compile('"[Aa]ctions":\\s*\\[.*?\\]')
-		var actions_regex = actions_pattern.search(file_text)
-		if not actions_regex:
-			actions_pattern.compile('"[Rr]aw[Aa]ctions":\\s*\\[.*?\\]')
-			actions_regex = actions_pattern.search(file_text)
-		if actions_regex:
-			var actions_text = actions_regex.get_string(0)
-			actions_text = actions_text.replace("'", '"')
-			actions_text = actions_text.insert(0, "{")
-			actions_text = actions_text.insert(actions_text.length(), "}")
-			var actions_data = JSON.parse_string(actions_text)
-			if actions_data:
-				var actions_list = actions_data[actions_data.keys()[0]]
-				var first_depth = round_to(clamp(actions_list[0].pos / 100, 0, 1), 4)
-				if inverted:
-					first_depth = round_to(1.0 - first_depth, 4)
-				file_data[0] = [first_depth, 1, 2, 0]
-				for action in actions_list:
-					var frame: int = action.at / (1000.0 / 60.0)
-					var depth = round_to(clamp(action.pos / 100, 0, 1), 4)
-					if inverted:
-						depth = round_to(1.0 - depth, 4)
-					file_data[frame] = [depth, 1, 2, 0]
-			else:
-				printerr("Failed to parse funscript JSON")
-		else:
-			printerr("No actions data found in the funscript")
+	if is_funscript:
+		frame_rate = 1000
+		file_data = fitted_markers(file_text)
 	else:
 		file_data = JSON.parse_string(file_text)
 		if not file_data:
-			printerr("Error: No JSON data found in file.")
-			return false
+			return {"error": "No JSON data found in file."}
 		if file_data.has("meta"):
 			var meta = file_data["meta"]
 			if meta is Dictionary and meta.has("video_offset_ms"):
-				%VideoPlayer/Main/VideoOffset/Input.value = meta["video_offset_ms"]
+				built["video_offset_ms"] = meta["video_offset_ms"]
+			if meta is Dictionary and meta.has("frame_rate"):
+				frame_rate = meta["frame_rate"]
 		if file_data.has("markers"):
 			file_data = file_data["markers"]
 	
-	var marker_data: Dictionary = file_data
-	if marker_data.size() < 6:
-		printerr("Error: Insufficient path data in file.")
-		return false
-	
-	var sorted_keys := marker_data.keys()
-	sorted_keys.sort_custom(func(a, b): return int(a) < int(b))
+	var marker_list: Array
+	for marker_frame in file_data:
+		marker_list.append([int(marker_frame), file_data[marker_frame]])
+	if marker_list.size() < 6:
+		return {"error": "Insufficient path data in file."}
+	marker_list.sort_custom(func(a, b): return a[0] < b[0])
 	
+	# Build packets, seek index and preview in a single pass. frames[i] is
+	# the display frame where the move sent by network_packets[i + 1] starts.
 	var network_packets: Array
-	for marker_frame in sorted_keys:
-		var marker = marker_data[marker_frame]
-		var ms_timing := int(round((float(marker_frame) / 60) * 1000))
-		network_packets.append(create_move_command(ms_timing, marker[0], marker[1], marker[2], marker[3]))
-		# Adjust for physics tick rate change from BounceX (60Hz to 50Hz)
-		marker_data[round(int(marker_frame) / 1.2)] = marker
-		marker_data.erase(marker_frame)
-	
-	network_paths.append(network_packets)
-	
+	network_packets.resize(marker_list.size())
+	var frames: PackedInt32Array
+	frames.resize(marker_list.size() - 1)
+	var path: PackedFloat32Array
+	var points: PackedVector2Array
 	var previous_depth: float
 	var previous_frame: int
-	var marker_list: Array = marker_data.keys()
-	var path: PackedFloat32Array
-	var frames: PackedInt32Array
-	var path_line := Line2D.new()
-	path_line.width = 15
-	path_line.hide()
-	marker_list.sort()
-	for marker_frame in marker_list:
-		var marker = marker_data[marker_frame]
-		var depth = marker[0]
-		var trans = marker[1]
-		var ease = marker[2]
-		if marker_frame > 0:
-			var steps: int = marker_frame - previous_frame
-			frames.append(previous_frame)
+	for i in marker_list.size():
+		var marker_frame: int = marker_list[i][0]
+		var marker = marker_list[i][1]
+		var depth: float = marker[0]
+		var ms_timing: int = roundi(marker_frame * 1000 / frame_rate)
+		network_packets[i] = create_move_command(ms_timing, depth, marker[1], marker[2], marker[3])
+		# Only the preview is quantized to the physics tick rate, moves keep
+		# their exact timing and are scheduled by the device clock
+		var display_frame: int = roundi(marker_frame * ticks_per_second / frame_rate)
+		if i > 0:
+			frames[i - 1] = previous_frame
+			var steps: int = display_frame - previous_frame
 			for step in steps:
-				var step_depth: float = Tween.interpolate_value(
+				var step_depth: float = FunscriptFitter.interpolate(
 						previous_depth,
-						depth - previous_depth,
-						step,
-						steps,
-						trans,
-						ease)
+						depth,
+						float(step) / steps,
+						marker[1],
+						marker[2],
+						marker[3])
 				path.append(step_depth)
 				var x_pos = (previous_frame * path_speed) + (step * path_speed)
-				var y_pos = render_depth(step_depth)
-				path_line.add_point(Vector2(x_pos, y_pos))
+				points.append(Vector2(x_pos, render_depth(step_depth)))
 		previous_depth = depth
-		previous_frame = marker_frame
-	paths.append(path)
-	marker_frames.append(frames)
-	$PathDisplay/Paths.add_child(path_line)
-	return true
+		previous_frame = display_frame
+	
+	built["packets"] = network_packets
+	built["frames"] = frames
+	built["path"] = path
+	built["points"] = points
+	return built
+
+
+# Fitted markers of a funscript keyed by ms. The GDScript fit is slow on
+# long scripts, so its result is cached by file content and tolerance and
+# only computed the first time a script is loaded.
+func fitted_markers(file_text: String) -> Dictionary:
+	var cache_path := "%s/%s_%d.json" % [
+			FIT_CACHE_DIR,
+			file_text.md5_text(),
+			roundi(fit_tolerance * 10000)]
+	if FileAccess.file_exists(cache_path):
+		var cached = JSON.parse_string(FileAccess.get_file_as_string(cache_path))
+		if cached is Dictionary:
+			return cached
+	
+	var file_data: Dictionary
+	var segments := FunscriptFitter.fit(FunscriptFitter.read_actions(file_text), fit_tolerance)
+	if segments.is_empty():
+		return file_data
+	file_data[0] = [round_to(segments[0][1], 4), 1, 2, 0]
+	for segment in segments:
+		file_data[segment[0]] = [round_to(segment[1], 4), segment[2], segment[3], segment[4]]
+	
+	DirAccess.make_dir_recursive_absolute(FIT_CACHE_DIR)
+	var cache = FileAccess.open(cache_path, FileAccess.WRITE)
+	if cache:
+		cache.store_string(JSON.stringify(file_data))
+		cache.close()
+	return file_data
 
 
 func create_delay(duration: float):
@@ -650,13 +800,7 @@ func display_active_path_index(pause := true, send_buffer := true):
 			if not %WebSocket.ossm_connected:
 				return
 			buffer_sent = 0
-			while buffer_sent < 6 and marker_index < network_paths[active_path_index].size():
-				%WebSocket.server.broadcast_binary(network_paths[active_path_index][marker_index])
-				marker_index += 1
-				buffer_sent += 1
-	else:
-		marker_index = 6
-		buffer_sent = 6
+			fill_move_buffer()
 	
 	$ActionPanel.clear_selections()
 	if pause:
@@ -699,15 +843,8 @@ func seek() -> void:
 	play_offset_ms = int(target_frame * 1000.0 / ticks_per_second)
 	
 	# Find the first marker_frame index AFTER target_frame
-	var frames = marker_frames[active_path_index]
-	var buffer_start := 0
-	var cascade_index := 0
-	for i in frames.size():
-		if frames[i] <= target_frame:
-			cascade_index = i
-			buffer_start = i + 1
-		else:
-			break
+	var buffer_start := marker_frames[active_path_index].bsearch(target_frame, false)
+	var cascade_index := maxi(buffer_start - 1, 0)
 	
 	# Update display
 	frame = target_frame
@@ -717,25 +854,27 @@ func seek() -> void:
 	update_time_display()
 	
 	if %WebSocket.ossm_connected:
-		send_command(OSSM.Command.RESET)
-		home_to(round(target_depth * 10000))
-		await homing_complete
+		# The device replays the seek target from its retained moves when it
+		# can, otherwise the queue is reset and refilled from the target
+		var next_marker_index: int = await device_seek(play_offset_ms, target_depth)
+		if not %WebSocket.ossm_connected:
+			_seeking = false
+			return
+		if next_marker_index >= 0:
+			await homing_complete
+			marker_index = next_marker_index
+		else:
+			send_command(OSSM.Command.RESET, cascade_index)
+			home_to(round(target_depth * 10000))
+			await homing_complete
+			# Send cascade packet (timestamp <= play_offset, firmware immediately skips it)
+			# followed by buffer packets from seek position
+			marker_index = cascade_index
 		if not %WebSocket.ossm_connected:
 			_seeking = false
 			return
-		# Send cascade packet (timestamp <= play_offset, firmware immediately skips it)
-		var cascade_packet = network_paths[active_path_index][cascade_index]
-		%WebSocket.server.broadcast_binary(cascade_packet)
-		# Send buffer packets from seek position
-		marker_index = buffer_start
-		buffer_sent = 0
-		while buffer_sent < 6 and marker_index < network_paths[active_path_index].size():
-			var packet = network_paths[active_path_index][marker_index]
-			var packet_ms = packet.decode_u32(1)
-			var packet_depth = packet.decode_u16(5)
-			%WebSocket.server.broadcast_binary(packet)
-			marker_index += 1
-			buffer_sent += 1
+		fill_move_buffer()
+		buffer_sent = marker_index - buffer_start
 	
 	if %VideoPlayer.is_active():
 		%VideoPlayer.pause_and_seek(play_offset_ms / 1000.0)
@@ -744,6 +883,45 @@ func seek() -> void:
 	_seek_dragging = false
 
 
+# Returns the marker index every device wants next, or -1 when the target
+# is outside any device's stroke history or the devices disagree
+func device_seek(time_ms: int, depth: float) -> int:
+	seek_replies.clear()
+	for client_id in moves_sent:
+		seek_replies[client_id] = null
+	if seek_replies.is_empty():
+		return -1
+	var command: PackedByteArray
+	command.resize(7)
+	command.encode_u8(0, OSSM.Command.SEEK)
+	command.encode_u32(1, time_ms)
+	command.encode_u16(5, round(remap(abs(motor_direction - depth), 0, 1, 0, 10000)))
+	%WebSocket.send_synchronized(command)
+	var next_marker_index: int = await seek_complete
+	if next_marker_index >= 0:
+		show_homing()
+	return next_marker_index
+
+
+func seek_reply(client_id: int, next_marker_index: int):
+	if not seek_replies.has(client_id):
+		return
+	seek_replies[client_id] = next_marker_index
+	check_seek_complete()
+
+
+func check_seek_complete():
+	if seek_replies.is_empty() or seek_replies.values().has(null):
+		return
+	var replies := seek_replies.values()
+	seek_replies.clear()
+	var next_marker_index: int = replies[0]
+	for reply in replies:
+		if reply != next_marker_index:
+			next_marker_index = -1
+	seek_complete.emit(next_marker_index)
+
+
 func _on_seek_slider_drag_started() -> void:
 	_seek_dragging = true
 
@@ -885,13 +1063,7 @@ func _on_video_player_played(video_time_seconds: float, from_stopped: bool):
 	frame = target_frame
 	
 	# Realign buffer tracking to new frame position
-	var frames = marker_frames[active_path_index]
-	var cascade_index := 0
-	for i in frames.size():
-		if frames[i] <= target_frame:
-			cascade_index = i
-		else:
-			break
+	var cascade_index := maxi(marker_frames[active_path_index].bsearch(target_frame, false) - 1, 0)
 	marker_index = mini(cascade_index + 1 + buffer_sent, network_paths[active_path_index].size())
 	
 	# Update display
@@ -27,7 +27,7 @@ func _physics_process(delta) -> void:
 		command.resize(5)
 		command.encode_u8(0, OSSM.Command.POSITION)
 		command.encode_u32(1, mapped_pos)
-		%WebSocket.server.broadcast_binary(command)
+		%WebSocket.send_realtime(command)
 		last_position = mapped_pos
 
 
@@ -76,6 +76,71 @@ func _on_homing_trigger_debounce_timer_timeout() -> void:
 	$HomingTriggerPopup.show()
 
 
+func _on_calibrate_vibration_pressed() -> void:
+	if not %WebSocket.ossm_connected:
+		return
+	$VBox/CalibrateVibration.disabled = true
+	$VBox/CalibrateVibration.text = "Calibrating vibration..."
+	owner.send_command(OSSM.Command.CALIBRATE_VIBRATION)
+
+
+func calibration_complete() -> void:
+	$VBox/CalibrateVibration.disabled = false
+	$VBox/CalibrateVibration.text = "Calibrate vibration response"
+
+
+# Strokes across the full user range at rising speeds, nothing may be attached
+func _on_auto_tune_limits_pressed() -> void:
+	if not %WebSocket.ossm_connected:
+		return
+	$VBox/AutoTuneLimits.disabled = true
+	$VBox/AutoTuneLimits.text = "Auto-tuning speed limits..."
+	owner.send_command(OSSM.Command.AUTOTUNE)
+
+
+func auto_tune_progress(stage: int) -> void:
+	if stage == OSSM.AutoTune.DONE or stage == OSSM.AutoTune.FAILED:
+		$VBox/AutoTuneLimits.disabled = false
+		$VBox/AutoTuneLimits.text = "Auto-tune speed limits"
+		if stage == OSSM.AutoTune.FAILED:
+			printerr("Auto-tune stalled at the first level, limits unchanged")
+
+
+# The device recalibrates once the stop is cleared
+func _on_clear_emergency_stop_pressed() -> void:
+	if not %WebSocket.ossm_connected:
+		return
+	var command: PackedByteArray
+	command.resize(2)
+	command.encode_u8(0, OSSM.Command.ESTOP)
+	command.encode_u8(1, 0)
+	%WebSocket.server.broadcast_binary(command)
+
+
+# Latency in microseconds while stopped, -1 once cleared
+func emergency_stop_state(latency_us: int) -> void:
+	$VBox/ClearEmergencyStop.disabled = latency_us < 0
+	if latency_us < 0:
+		%WiFi.self_modulate = Color.SEA_GREEN
+		return
+	printerr("Emergency stop, step generation halted in %d us" % latency_us)
+	%WiFi.self_modulate = Color.RED
+	%VibrationControls.set_process(false)
+	%PositionControls.set_physics_process(false)
+	owner.paused = true
+
+
+# Tuned maxima reported by the device become the slider maxima
+func apply_tuned_limit(command: int, value: int) -> void:
+	match command:
+		OSSM.Command.SET_SPEED_LIMIT:
+			$VBox/Sliders/MaxSpeed/Input.value = value
+		OSSM.Command.SET_GLOBAL_ACCELERATION:
+			$VBox/Sliders/MaxAcceleration/Input.value = value
+	%SpeedPanel.update_speed()
+	%SpeedPanel.update_acceleration()
+
+
 func _on_always_on_top_toggled(toggled):
 	DisplayServer.window_set_flag(DisplayServer.WINDOW_FLAG_ALWAYS_ON_TOP, toggled)
 	owner.user_settings.set_value('window', 'always_on_top', toggled)
@@ -12,6 +12,7 @@ var slider_max: float
 var range_percent: int
 var half_period_ms: int
 var origin_position: int
+var waveform: int = OSSM.Waveform.SQUARE
 
 var pulse_active: bool
 var pulse_length_ms: int
@@ -124,16 +125,27 @@ func send_vibrate_command(duration: int = -1) -> void:
 	if paused or not %WebSocket.ossm_connected:
 		return
 	var command:PackedByteArray
-	command.resize(13)
+	command.resize(18)
 	command.encode_u8(0, OSSM.Command.VIBRATE)
 	command.encode_s32(1, duration)
 	command.encode_u32(5, half_period_ms)
 	command.encode_u16(9, abs(owner.motor_direction * 10000 - origin_position))
 	command.encode_u8(11, range_percent)
 	command.encode_u8(12, $Waveform/HSlider.value)
+	command.encode_u8(13, waveform)
+	command.encode_u32(14, half_period_ms * 2000)
 	%WebSocket.server.broadcast_binary(command)
 
 
+# Device reports the range it could actually reach at this frequency
+func show_delivered_range(delivered: int) -> void:
+	var delivered_percent: int = round(delivered * 0.01)
+	if delivered_percent < range_percent:
+		$RangeSlider/ValueLabel.text = "%d%%\n(%d%%)" % [range_percent, delivered_percent]
+	else:
+		$RangeSlider/ValueLabel.text = str(range_percent) + "%"
+
+
 func update_blocked_indicator() -> void:
 	$PositionSlider/MinLimit.visible = owner.motor_direction == 1
 	$PositionSlider/MaxLimit.visible = owner.motor_direction == 0
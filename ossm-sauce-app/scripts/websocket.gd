@@ -8,6 +8,23 @@ var host: String = "0.0.0.0"
 var server_started: bool
 var ossm_connected: bool
 var ping_timer: Timer
+var flight_recorder := FlightRecorder.new()
+
+# Device UDP port for real-time POSITION updates, 0 keeps them on the websocket.
+# One peer per device that opened a channel, keyed by client_id.
+var udp_port: int = 0
+var udp_peers: Dictionary
+var udp_sequence: int
+
+# Group playback, every device keeps a clock in step with the app's and
+# PLAY, PAUSE and SEEK are scheduled on it when more than one is connected
+const GROUP_LEAD_MS: int = 150
+var clock_sync_timer: Timer
+var clock_sync_sent: Dictionary
+var clock_round_trip: Dictionary
+var phase_errors: Dictionary
+
+signal recording_saved(path: String)
 
 func _ready():
 	server = WebSocketServer.new()
@@ -20,6 +37,10 @@ func _ready():
 	ping_timer.wait_time = 3.0
 	ping_timer.timeout.connect(func(): server.broadcast_ping())
 	add_child(ping_timer)
+	clock_sync_timer = Timer.new()
+	clock_sync_timer.wait_time = 1.0
+	clock_sync_timer.timeout.connect(sync_clocks)
+	add_child(clock_sync_timer)
 
 
 func start_server():
@@ -27,6 +48,7 @@ func start_server():
 	if server_started:
 		print("WebSocket server started successfully on port %d" % port)
 		ping_timer.start()
+		clock_sync_timer.start()
 	else:
 		printerr("Failed to start WebSocket server on port %d" % port)
 	
@@ -64,6 +86,11 @@ func _on_client_connected(client_id):
 
 func _on_client_disconnected(client_id, code):
 	print("Client disconnected: #%d (code: %d)" % [client_id, code])
+	clock_sync_sent.erase(client_id)
+	clock_round_trip.erase(client_id)
+	phase_errors.erase(client_id)
+	close_udp_channel(client_id)
+	owner.remove_move_client(client_id)
 	update_client_count()
 	if server.get_client_count() == 0:
 		_on_client_disconnected_cleanup()
@@ -74,7 +101,18 @@ func _on_message_received(client_id, message):
 
 
 func _on_data_received(client_id, data):
+	if data[0] == OSSM.Command.RECORDER_DUMP:
+		if flight_recorder.add_frame(data):
+			var path := flight_recorder.save()
+			print("Flight recording saved to %s" % path)
+			recording_saved.emit(path)
+		return
 	if data[0] == OSSM.Command.RESPONSE:
+		if data.size() >= 5:
+			var moves_received: int = data.decode_u16(3)
+			if data[1] == OSSM.Command.CONNECTION:
+				owner.add_move_client(client_id, moves_received)
+			owner.update_move_credits(client_id, data[2], moves_received)
 		match data[1]:
 			OSSM.Command.CONNECTION:
 				%WiFi.self_modulate = Color.SEA_GREEN
@@ -92,31 +130,134 @@ func _on_data_received(client_id, data):
 				
 				ossm_connected = true
 				owner.apply_device_settings()
+				open_udp_channel(client_id)
+				sync_clocks()
 				
 				# Reset and home to base by reselecting mode
 				%Menu._on_mode_selected(%Menu/Main/Mode.selected)
 			
 			OSSM.Command.HOMING:
-				%CircleSelection.hide()
-				%CircleSelection.homing_lock = false
-				%ActionPanel.disable_buttons(false)
-				var displays = [
-					%PathDisplay,
-					%PositionControls,
-					%LoopControls,
-					%VibrationControls,
-					%BridgeControls,
-					%ActionPanel,
-					%VideoPlayer,
-					%Settings,
-					%AddFile,
-					%Menu]
-				for node in displays:
-					node.modulate.a = 1
+				owner.hide_homing()
 				owner.emit_signal("homing_complete")
 				if AppMode.active == AppMode.MOVE:
 					if owner.active_path_index != null and owner.frame == 0:
 						%CircleSelection.show_play()
+			
+			OSSM.Command.VIBRATE:
+				if data.size() >= 9:
+					%VibrationControls.show_delivered_range(data.decode_s32(5))
+			
+			OSSM.Command.CALIBRATE_VIBRATION:
+				%Settings.calibration_complete()
+			
+			OSSM.Command.SEEK:
+				if data.size() >= 9:
+					owner.seek_reply(client_id, data.decode_s32(5))
+			
+			OSSM.Command.ESTOP:
+				if data.size() >= 9:
+					%Settings.emergency_stop_state(data.decode_s32(5))
+			
+			OSSM.Command.AUTOTUNE:
+				if data.size() >= 9:
+					%Settings.auto_tune_progress(data.decode_s32(5))
+			
+			OSSM.Command.SET_SPEED_LIMIT, OSSM.Command.SET_GLOBAL_ACCELERATION:
+				if data.size() >= 9:
+					%Settings.apply_tuned_limit(data[1], data.decode_s32(5))
+			
+			OSSM.Command.RECALIBRATE:
+				if data.size() >= 9:
+					owner.recalibration_progress(data.decode_s32(5))
+			
+			OSSM.Command.CLOCK_SYNC:
+				if data.size() >= 9 and clock_sync_sent.has(client_id):
+					var round_trip: int = Time.get_ticks_msec() - clock_sync_sent[client_id]
+					# Smallest round trip seen, creeping up so a slower link is followed
+					clock_round_trip[client_id] = min(round_trip, clock_round_trip.get(client_id, round_trip) + 1)
+					clock_sync_sent.erase(client_id)
+					phase_errors[client_id] = data.decode_s32(5)
+					if abs(phase_errors[client_id]) > 10:
+						print("Device #%d phase error: %d ms" % [client_id, phase_errors[client_id]])
+			
+			OSSM.Command.UDP_CHANNEL:
+				close_udp_channel(client_id)
+				if data.size() >= 9 and data.decode_u32(5) != 0:
+					var address := "%d.%d.%d.%d" % [data[5], data[6], data[7], data[8]]
+					var udp_peer := PacketPeerUDP.new()
+					udp_peer.connect_to_host(address, udp_port)
+					udp_peers[client_id] = udp_peer
+					print("Streaming positions to device #%d over UDP at %s:%d" % [client_id, address, udp_port])
+
+
+func open_udp_channel(client_id: int):
+	if udp_port == 0:
+		return
+	var command: PackedByteArray
+	command.resize(3)
+	command.encode_u8(0, OSSM.Command.UDP_CHANNEL)
+	command.encode_u16(1, udp_port)
+	server.send_binary(client_id, command)
+
+
+func close_udp_channel(client_id: int):
+	if udp_peers.has(client_id):
+		udp_peers[client_id].close()
+		udp_peers.erase(client_id)
+
+
+func group_now_ms() -> int:
+	return Time.get_ticks_msec() & 0xFFFFFFFF
+
+
+func sync_clocks():
+	for client_id in server.get_client_ids():
+		var command: PackedByteArray
+		command.resize(5)
+		command.encode_u8(0, OSSM.Command.CLOCK_SYNC)
+		command.encode_u32(1, (group_now_ms() + clock_round_trip.get(client_id, 0) / 2) & 0xFFFFFFFF)
+		clock_sync_sent[client_id] = Time.get_ticks_msec()
+		server.send_binary(client_id, command)
+
+
+# How far ahead synchronized commands are scheduled, 0 with a single device
+func group_lead_ms() -> int:
+	return GROUP_LEAD_MS if server.get_client_count() > 1 else 0
+
+
+# Sends a command so it takes effect lead_ms from now on every device,
+# -1 uses group_lead_ms()
+func send_synchronized(command: PackedByteArray, lead_ms: int = -1):
+	if lead_ms < 0:
+		lead_ms = group_lead_ms()
+	if lead_ms == 0:
+		server.broadcast_binary(command)
+		return
+	var scheduled: PackedByteArray
+	scheduled.resize(5)
+	scheduled.encode_u8(0, OSSM.Command.SCHEDULE)
+	scheduled.encode_u32(1, (group_now_ms() + lead_ms) & 0xFFFFFFFF)
+	scheduled.append_array(command)
+	server.broadcast_binary(scheduled)
+
+
+# Commands where only the newest packet matters, sent over UDP to every
+# device that opened a channel and over the websocket to the rest.
+# Sequence numbers let the device drop late ones.
+func send_realtime(command: PackedByteArray):
+	if udp_peers.is_empty():
+		server.broadcast_binary(command)
+		return
+	udp_sequence = (udp_sequence + 1) & 0xFFFFFFFF
+	var datagram: PackedByteArray
+	datagram.resize(4)
+	datagram.encode_u32(0, udp_sequence)
+	datagram.append_array(command)
+	for client_id in server.get_client_ids():
+		if udp_peers.has(client_id):
+			udp_peers[client_id].put_packet(datagram)
+		else:
+			server.send_binary(client_id, command)
 
 
 func _on_client_disconnected_cleanup():
@@ -137,6 +278,7 @@ func _on_client_disconnected_cleanup():
 	for node in display:
 		node.modulate.a = 1
 	owner.emit_signal("homing_complete")
+	owner.emit_signal("seek_complete", -1)
 
 
 func _on_server_error(error):
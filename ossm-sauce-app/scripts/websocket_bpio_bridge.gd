@@ -2,7 +2,7 @@ extends Node
 
 ## Buttplug.io WebSocket bridge
 ## Connects to Intiface Central via WSDM (device emulation),
-## receives TCode commands, and forwards them to the OSSM.
+## receives TCode commands, and relays them to the OSSM which parses them.
 
 var ws_client: WebSocketPeer
 var ws_device: WebSocketPeer
@@ -10,15 +10,6 @@ var ws_device: WebSocketPeer
 var device_connected: bool
 var client_connected: bool
 
-var tcode_regex: RegEx
-
-enum { EASE_IN, EASE_OUT, EASE_IN_OUT, EASE_OUT_IN }
-
-
-func _ready():
-	tcode_regex = RegEx.new()
-	tcode_regex.compile("([LRVA])(\\d+)(I(\\d+))?(S(\\d+))?")
-
 
 func start_device():
 	if not %BridgeControls/Controls/Enable.button_pressed:
@@ -139,46 +130,22 @@ func _process(_delta):
 		var packet = ws_device.get_packet()
 		if packet.size() == 0:
 			continue
-		var msg = packet.get_string_from_utf8()
-		_log("T-code: " + msg)
-		for line in msg.split('\n'):
-			var cmd = line.strip_edges()
-			if cmd != "":
-				_translate_and_forward(cmd)
-
-
-func _translate_and_forward(tcode_cmd: String):
-	for result in tcode_regex.search_all(tcode_cmd):
-		var type = result.get_string(1)
-		var digits = result.get_string(2)
-		var channel = int(digits[0])
-		var value_str = digits.substr(1)
-		var magnitude = int(value_str)
-		var interval = int(result.get_string(4)) if result.get_string(4) != "" else 0
-		if channel != 0:
-			continue
-		match type:
-			"L":
-				# Intiface sends 0-1000 range (0%=0, 100%=1000)
-				var depth: int = clampi(magnitude * 10, 0, 10000)
-				var ms_duration: int = clampi(interval if interval > 0 else 100, %BridgeControls.min_move_duration, %BridgeControls.max_move_duration)
-				_log("  → magnitude=%d, depth=%d, duration=%dms" % [magnitude, depth, ms_duration])
-				send_smooth_move(ms_duration, depth, %BridgeControls.auto_smoothing, EASE_IN_OUT, 0)
-			"V":
-				pass # TODO: Map to OSSM vibrate
-
-
-func send_smooth_move(ms_duration: int, depth: int, trans: int, ease: int, auxiliary: int):
+		_log("T-code: " + packet.get_string_from_utf8())
+		send_tcode(packet)
+
+
+# The firmware parses T-Code itself, bridge settings ride along as options
+func send_tcode(text: PackedByteArray):
 	if not %WebSocket.ossm_connected:
 		return
 	var command: PackedByteArray
-	command.resize(10)
-	command.encode_u8(0, OSSM.Command.SMOOTH_MOVE)
-	command.encode_u32(1, ms_duration)
-	command.encode_u16(5, abs(owner.motor_direction * 10000 - depth))
-	command.encode_u8(7, trans)
-	command.encode_u8(8, ease)
-	command.encode_u8(9, auxiliary)
+	command.resize(7)
+	command.encode_u8(0, OSSM.Command.TCODE)
+	command.encode_u8(1, %BridgeControls.auto_smoothing)
+	command.encode_u8(2, owner.motor_direction)
+	command.encode_u16(3, clampi(%BridgeControls.min_move_duration, 0, 0xFFFF))
+	command.encode_u16(5, clampi(%BridgeControls.max_move_duration, 0, 0xFFFF))
+	command.append_array(text)
 	%WebSocket.server.broadcast_binary(command)
 
 
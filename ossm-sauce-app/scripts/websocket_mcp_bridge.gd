@@ -15,6 +15,10 @@ func _on_mcp_command_received(command_data):
 				handle_websocket_connect(command_data.url)
 			"disconnect":
 				handle_websocket_disconnect()
+			"recorder_dump":
+				handle_recorder_dump()
+			"recorder_replay":
+				handle_recorder_replay(command_data.file, command_data.speed)
 			_:
 				_log("WebSocket MCP Bridge: Unknown action: " + command_data.action)
 	
@@ -44,6 +48,27 @@ func handle_websocket_disconnect():
 		_log("WebSocket MCP Bridge: Server already stopped")
 
 
+func handle_recorder_dump():
+	var command: PackedByteArray = [OSSM.Command.RECORDER_DUMP]
+	%WebSocket.server.broadcast_binary(command)
+	var path: String = await %WebSocket.recording_saved
+	_log("WebSocket MCP Bridge: Flight recording saved to " + path)
+
+
+# Resends a saved flight recording with its original command timing
+func handle_recorder_replay(path: String, speed: float):
+	var schedule := FlightRecorder.replay_schedule(FlightRecorder.load_entries(path), maxf(speed, 0.01))
+	_log("WebSocket MCP Bridge: Replaying " + str(schedule.size()) + " commands from " + path)
+	for step in schedule:
+		if step[0] > 0:
+			await get_tree().create_timer(step[0]).timeout
+		if not %WebSocket.server.is_listening():
+			_log("WebSocket MCP Bridge: Replay stopped, server not listening")
+			return
+		%WebSocket.server.broadcast_binary(step[1])
+	_log("WebSocket MCP Bridge: Replay complete")
+
+
 func broadcast_binary_command(binary_data: PackedByteArray):
 	%WebSocket.server.broadcast_binary(binary_data)
 	
@@ -75,6 +100,21 @@ func get_command_name(command_type: int) -> String:
 		0x0D: return "SET_HOMING_SPEED"
 		0x0E: return "SET_HOMING_TRIGGER"
 		0x0F: return "SMOOTH_MOVE"
+		0x10: return "VIBRATE_TABLE"
+		0x11: return "CALIBRATE_VIBRATION"
+		0x12: return "OVERLAY"
+		0x13: return "PATTERN_UPLOAD"
+		0x14: return "PATTERN_CONTROL"
+		0x15: return "SEEK"
+		0x16: return "RECORDER_DUMP"
+		0x17: return "TCODE"
+		0x18: return "SERIAL_MODE"
+		0x19: return "UDP_CHANNEL"
+		0x1A: return "CLOCK_SYNC"
+		0x1B: return "SCHEDULE"
+		0x1C: return "RECALIBRATE"
+		0x1D: return "AUTOTUNE"
+		0x1E: return "ESTOP"
 		_: return "UNKNOWN(" + str(command_type) + ")"
 
 